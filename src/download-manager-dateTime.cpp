@@ -115,6 +115,37 @@ int DateUtil::getDiffDays(time_t nowTime,time_t refTime)
 	return diffDays;
 }
 
+void DateUtil::getDayBoundary(DayBoundary &boundary)
+{
+	time_t now = time(NULL);
+	struct tm nowDate;
+	localtime_r(&now, &nowDate);
+	nowDate.tm_hour = 0;
+	nowDate.tm_min = 0;
+	nowDate.tm_sec = 0;
+	nowDate.tm_isdst = -1;
+	boundary.today = mktime(&nowDate);
+	/* mktime normalizes the day of month */
+	nowDate.tm_mday--;
+	nowDate.tm_isdst = -1;
+	boundary.yesterday = mktime(&nowDate);
+	nowDate.tm_mday += 2;
+	nowDate.tm_isdst = -1;
+	boundary.tomorrow = mktime(&nowDate);
+}
+
+int DateUtil::getDateGroupType(DayBoundary &boundary, time_t refTime)
+{
+	if (refTime >= boundary.tomorrow)
+		return DATETIME::DATE_TYPE_LATER;
+	else if (refTime >= boundary.today)
+		return DATETIME::DATE_TYPE_TODAY;
+	else if (refTime >= boundary.yesterday)
+		return DATETIME::DATE_TYPE_YESTERDAY;
+	else
+		return DATETIME::DATE_TYPE_PREVIOUS;
+}
+
 UDateFormat *DateUtil::getBestPattern(const char *patternStr,
 	UDateTimePatternGenerator *generator, const char *locale)
 {
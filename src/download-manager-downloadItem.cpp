@@ -22,12 +22,50 @@
 
 #include <Ecore.h>
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <deque>
+#include <new>
+#include <tr1/unordered_map>
 #include "download-manager-downloadItem.h"
 #include "download-manager-common.h"
 #include "app_service.h"
 
-static Ecore_Pipe *ecore_pipe = NULL;
-static void __ecore_cb_pipe_update(void *data, void *buffer, unsigned int nbyte);
+/* The count of callback events which can wait for the main loop.
+ * It should be power of 2 */
+#define DA_CB_RING_SIZE 256
+#define DA_CB_RING_MASK (DA_CB_RING_SIZE - 1)
+
+/* Progress events which are handled at the main loop,
+ * and ones which are merged to an already queued progress event */
+static unsigned long progress_delivered_count = 0;
+static unsigned long progress_coalesced_count = 0;
+
+/* Each download handle gets a callback id which is never reused.
+ * The id is given to the download agent as the user data instead of the
+ * download item, so the agent thread never touches the item.
+ * The main loop finds the item by the id. An event of a destroyed handle
+ * or item is dropped, because its id is not found.
+ * These are used only at the main loop */
+static unsigned long cb_next_id = 0;
+static tr1::unordered_map<unsigned long, DownloadItem *> cb_items;
+
+/* Latest progress of each callback id.
+ * It is kept by the engine instead of the download item, because the
+ * download agent thread cannot know whether the item is destroyed.
+ * A slot lives from createHandle() until destroyHandle().
+ * Only one progress event is queued to the main loop until it is taken */
+struct ProgressSlot {
+	unsigned long long received;
+	unsigned long long total;
+	bool isQueued;
+};
+static pthread_mutex_t progress_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tr1::unordered_map<unsigned long, ProgressSlot> progress_slots;
 
 namespace DA_CB {
 enum TYPE {
@@ -39,38 +77,227 @@ enum TYPE {
 };
 }
 
+/* String which is kept in the event record.
+ * It does not use heap unless the string is longer than the inline buffer */
+template <int N>
+struct CbString {
+	char inlineBuf[N];
+	char *heapBuf;
+
+	inline void init(void) { inlineBuf[0] = '\0'; heapBuf = NULL; }
+	inline bool isEmpty(void) { return get()[0] == '\0'; }
+	inline const char *get(void) { return heapBuf ? heapBuf : inlineBuf; }
+	void set(const char *str) {
+		if (!str)
+			return;
+		size_t len = strlen(str);
+		if (len < N) {
+			memcpy(inlineBuf, str, len + 1);
+		} else {
+			heapBuf = strdup(str);
+			if (!heapBuf)
+				inlineBuf[0] = '\0';
+		}
+	}
+	inline void release(void) { free(heapBuf); init(); }
+};
+
+#define DA_CB_NAME_LEN 128
+#define DA_CB_MIME_LEN 64
+#define DA_CB_PATH_LEN 256
+
+/* Event record of the download agent callback.
+ * Only the data of its type is kept. The progress values are not kept here
+ * because they are taken from the download item when the event is handled */
 class CbData {
 public:
-	CbData() {}
-	~CbData() {}
+	CbData() { m_type = DA_CB::STARTED; initData(); }
+	~CbData() { reset(); }
 
 	void updateDownloadItem();
+	void reset();
 
-	inline void setType(DA_CB::TYPE type) { m_type = type; }
-	inline void setUserData(void *userData) { m_userData = userData; }
+	inline void setType(DA_CB::TYPE type) { m_type = type; initData(); }
+	inline void setUserData(void *userData) { m_cbId = (unsigned long)(uintptr_t)userData; }
 	inline void setDownloadHandle(url_download_h handle) { m_download_handle = handle; }
-	inline void setReceivedFileSize(unsigned long int size) { m_receivedFileSize = size; }
-	inline void setFileSize(unsigned long int size) { m_fileSize = size; }
-	inline void setContentName(const char *name) { if (name) m_contentName = name; }
-	inline void setRegisteredFilePath(const char *path) { if (path) m_registeredFilePath = path; }
-	inline void setMimeType(const char *mime) { m_mimeType = mime; }
-	inline void setErrorCode(int err) { m_error = err;	}
+	inline void setContentName(const char *name) { m_data.started.contentName.set(name); }
+	inline void setRegisteredFilePath(const char *path) { m_data.completed.registeredFilePath.set(path); }
+	inline void setMimeType(const char *mime) { m_data.started.mimeType.set(mime); }
+	inline void setErrorCode(int err) { m_data.stopped.error = err; }
 
 private:
+	void initData();
+
 	DA_CB::TYPE m_type;
-	void *m_userData;
+	/* Callback id of the download item */
+	unsigned long m_cbId;
 	url_download_h m_download_handle;
-	int m_error;
-	unsigned long int m_receivedFileSize;
-	unsigned long int m_fileSize;
-	string m_contentName;
-	string m_registeredFilePath;
-	string m_mimeType;
+	union {
+		struct {
+			CbString<DA_CB_NAME_LEN> contentName;
+			CbString<DA_CB_MIME_LEN> mimeType;
+		} started;
+		struct {
+			CbString<DA_CB_PATH_LEN> registeredFilePath;
+		} completed;
+		struct {
+			int error;
+		} stopped;
+	} m_data;
 };
 
-struct pipe_data_t {
-	CbData *cbData;
-};
+/* Ring of callback events. The main loop is the only consumer.
+ * The download agent may call the callbacks from more than one thread.
+ * The producers are serialized by cb_producer_mutex, which is held
+ * from __acquire_cb_data() until __post_cb_data(). It never waits for
+ * the consumer while holding it.
+ * The producer only moves the tail, and the consumer only moves the head.
+ * The main loop is woken up by the eventfd once per batch of events */
+static CbData cb_ring[DA_CB_RING_SIZE];
+static volatile unsigned int cb_ring_head = 0;
+static volatile unsigned int cb_ring_tail = 0;
+static pthread_mutex_t cb_producer_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Events which are posted while the ring is full.
+ * While it has events, new ones are added here too to keep the order.
+ * They are protected by cb_producer_mutex */
+static deque<CbData *> cb_overflow;
+static CbData *cb_overflow_data = NULL;
+static unsigned long cb_overflow_count = 0;
+/* Set by deinitEngine() to stop the producers */
+static int cb_is_closing = 0;
+static int cb_event_fd = -1;
+static int cb_wakeup_pending = 0;
+static Ecore_Fd_Handler *cb_fd_handler = NULL;
+static unsigned long cb_event_count = 0;
+static unsigned long cb_wakeup_count = 0;
+
+static Eina_Bool __cb_event_fd_handler(void *data, Ecore_Fd_Handler *fd_handler);
+
+/* Called at the download agent thread.
+ * Return the free slot at the tail. It is published by __post_cb_data().
+ * The producer lock is kept until then if it returns the slot.
+ * The ring is full only if the main loop is blocked. It is not waited for.
+ * A progress event is dropped if canDrop is set, because the next progress
+ * callback queues it again. Other events are allocated not to lose
+ * a state change */
+static CbData *__acquire_cb_data(bool canDrop)
+{
+	pthread_mutex_lock(&cb_producer_mutex);
+	if (cb_event_fd < 0 || cb_is_closing) {
+		DP_LOGE("download engine is not initialized");
+		pthread_mutex_unlock(&cb_producer_mutex);
+		return NULL;
+	}
+	if (!cb_overflow.empty() ||
+			cb_ring_tail - cb_ring_head >= DA_CB_RING_SIZE) {
+		if (!canDrop)
+			cb_overflow_data = new (nothrow) CbData();
+		if (!cb_overflow_data) {
+			if (!canDrop)
+				DP_LOGE("Fail to allocate a callback event");
+			pthread_mutex_unlock(&cb_producer_mutex);
+			return NULL;
+		}
+		return cb_overflow_data;
+	}
+	__sync_synchronize();
+	return &cb_ring[cb_ring_tail & DA_CB_RING_MASK];
+}
+
+static void __post_cb_data(void)
+{
+	if (cb_overflow_data) {
+		cb_overflow.push_back(cb_overflow_data);
+		cb_overflow_data = NULL;
+		cb_overflow_count++;
+	} else {
+		__sync_synchronize();
+		cb_ring_tail = cb_ring_tail + 1;
+		__sync_synchronize();
+	}
+	if (__sync_lock_test_and_set(&cb_wakeup_pending, 1) == 0) {
+		if (eventfd_write(cb_event_fd, 1) < 0)
+			DP_LOGE("Fail to write eventfd");
+	}
+	pthread_mutex_unlock(&cb_producer_mutex);
+}
+
+static void __add_progress_slot(unsigned long cbId)
+{
+	ProgressSlot slot = {0, 0, false};
+	pthread_mutex_lock(&progress_mutex);
+	progress_slots[cbId] = slot;
+	pthread_mutex_unlock(&progress_mutex);
+}
+
+static void __remove_progress_slot(unsigned long cbId)
+{
+	pthread_mutex_lock(&progress_mutex);
+	progress_slots.erase(cbId);
+	pthread_mutex_unlock(&progress_mutex);
+}
+
+/* Called at the download agent thread.
+ * Return true if a progress event should be queued to the main loop */
+static bool __set_pending_progress(unsigned long cbId,
+	unsigned long long received, unsigned long long total)
+{
+	bool needQueue = false;
+	pthread_mutex_lock(&progress_mutex);
+	tr1::unordered_map<unsigned long, ProgressSlot>::iterator it =
+		progress_slots.find(cbId);
+	if (it != progress_slots.end()) {
+		it->second.received = received;
+		it->second.total = total;
+		if (!it->second.isQueued) {
+			it->second.isQueued = true;
+			needQueue = true;
+		}
+	}
+	pthread_mutex_unlock(&progress_mutex);
+	return needQueue;
+}
+
+/* Called at the download agent thread if the event cannot be queued.
+ * The next progress callback tries to queue it again */
+static void __cancel_pending_progress(unsigned long cbId)
+{
+	pthread_mutex_lock(&progress_mutex);
+	tr1::unordered_map<unsigned long, ProgressSlot>::iterator it =
+		progress_slots.find(cbId);
+	if (it != progress_slots.end())
+		it->second.isQueued = false;
+	pthread_mutex_unlock(&progress_mutex);
+}
+
+/* Called at the main loop when the queued progress event is handled.
+ * Return false if the handle is already destroyed */
+static bool __take_pending_progress(unsigned long cbId,
+	unsigned long long *received, unsigned long long *total)
+{
+	bool ret = false;
+	pthread_mutex_lock(&progress_mutex);
+	tr1::unordered_map<unsigned long, ProgressSlot>::iterator it =
+		progress_slots.find(cbId);
+	if (it != progress_slots.end()) {
+		*received = it->second.received;
+		*total = it->second.total;
+		it->second.isQueued = false;
+		ret = true;
+	}
+	pthread_mutex_unlock(&progress_mutex);
+	return ret;
+}
+
+/* Return NULL if the handle of the id is already destroyed */
+static DownloadItem *__find_cb_item(unsigned long cbId)
+{
+	tr1::unordered_map<unsigned long, DownloadItem *>::iterator it =
+		cb_items.find(cbId);
+	if (it == cb_items.end())
+		return NULL;
+	return it->second;
+}
 
 DownloadEngine::DownloadEngine()
 {
@@ -83,65 +310,121 @@ DownloadEngine::~DownloadEngine()
 
 void DownloadEngine::initEngine(void)
 {
-	ecore_pipe = ecore_pipe_add(__ecore_cb_pipe_update, NULL);
+	cb_is_closing = 0;
+	cb_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (cb_event_fd < 0) {
+		DP_LOGE("Fail to create eventfd");
+		return;
+	}
+	cb_fd_handler = ecore_main_fd_handler_add(cb_event_fd, ECORE_FD_READ,
+		__cb_event_fd_handler, NULL, NULL, NULL);
+	if (!cb_fd_handler)
+		DP_LOGE("Fail to add fd handler");
 }
 
 void DownloadEngine::deinitEngine(void)
 {
 	DP_LOG_FUNC();
-	if (ecore_pipe) {
-		ecore_pipe_del(ecore_pipe);
-		ecore_pipe = NULL;
+	DP_LOG("progress events delivered[%lu] coalesced[%lu]",
+		deliveredProgressCount(), coalescedProgressCount());
+	DP_LOG("callback events[%lu] wakeups[%lu] overflow[%lu]", cb_event_count,
+		cb_wakeup_count, cb_overflow_count);
+	/* Stop the producers before closing the eventfd */
+	pthread_mutex_lock(&cb_producer_mutex);
+	cb_is_closing = 1;
+	if (cb_fd_handler) {
+		ecore_main_fd_handler_del(cb_fd_handler);
+		cb_fd_handler = NULL;
 	}
+	/* Drop the events which are not handled yet */
+	while (cb_ring_head != cb_ring_tail) {
+		cb_ring[cb_ring_head & DA_CB_RING_MASK].reset();
+		cb_ring_head = cb_ring_head + 1;
+	}
+	while (!cb_overflow.empty()) {
+		delete cb_overflow.front();
+		cb_overflow.pop_front();
+	}
+	if (cb_event_fd >= 0) {
+		close(cb_event_fd);
+		cb_event_fd = -1;
+	}
+	pthread_mutex_unlock(&cb_producer_mutex);
+}
+
+unsigned long DownloadEngine::deliveredProgressCount(void)
+{
+	return __sync_fetch_and_add(&progress_delivered_count, 0);
+}
+
+unsigned long DownloadEngine::coalescedProgressCount(void)
+{
+	return __sync_fetch_and_add(&progress_coalesced_count, 0);
 }
 
 void CbData::updateDownloadItem()
 {
 //	DP_LOGD_FUNC();
 
-	if (!m_userData) {
-		DP_LOGE("download item is NULL");
+	unsigned long long received = 0;
+	unsigned long long total = 0;
+	/* An event of a destroyed handle or item is dropped
+	 * without touching the download item */
+	DownloadItem *downloadItem = __find_cb_item(m_cbId);
+	if (!downloadItem) {
+		DP_LOGD("download handle of [%lu] is already destroyed", m_cbId);
 		return;
 	}
+	if (m_type == DA_CB::PROGRESS &&
+			!__take_pending_progress(m_cbId, &received, &total))
+		return;
 
-	DownloadItem *downloadItem = static_cast<DownloadItem*>(m_userData);
 	if (downloadItem->state() == DL_ITEM::FAILED) {
 		DP_LOGE("download item is already failed");
 		return;
 	}
 	downloadItem->setDownloadHandle(m_download_handle);
+	DL_ITEM::STATE oldState = downloadItem->state();
+	unsigned int changed = CHANGE::NONE;
 
 	switch(m_type) {
 	case DA_CB::STARTED:
 		downloadItem->setState(DL_ITEM::STARTED);
 		//downloadItem->setFileSize(m_fileSize);
-		if (!m_contentName.empty())
-			downloadItem->setContentName(m_contentName);
-		if (!m_mimeType.empty())
-			downloadItem->setMimeType(m_mimeType);
+		changed |= CHANGE::TITLE;
+		if (!m_data.started.contentName.isEmpty()) {
+			string name = m_data.started.contentName.get();
+			downloadItem->setContentName(name);
+		}
+		if (!m_data.started.mimeType.isEmpty())
+			downloadItem->setMimeType(m_data.started.mimeType.get());
 		break;
 	case DA_CB::PROGRESS:
+		__sync_fetch_and_add(&progress_delivered_count, 1);
 		downloadItem->setState(DL_ITEM::UPDATING);
-		downloadItem->setFileSize(m_fileSize);
-		downloadItem->setReceivedFileSize(m_receivedFileSize);
+		downloadItem->setFileSize(total);
+		downloadItem->setReceivedFileSize(received);
+		changed |= CHANGE::PROGRESS;
 		break;
 	case DA_CB::PAUSED:
 		downloadItem->setState(DL_ITEM::SUSPENDED);
-		downloadItem->setFileSize(m_fileSize);
-		downloadItem->setReceivedFileSize(m_receivedFileSize);
 		break;
 	case DA_CB::COMPLETED:
 		downloadItem->setState(DL_ITEM::FINISHED);
-		if (!m_registeredFilePath.empty()) {
-			DP_LOGD("registeredFilePath[%s]", m_registeredFilePath.c_str());
-			downloadItem->setRegisteredFilePath(m_registeredFilePath);
+		if (!m_data.completed.registeredFilePath.isEmpty()) {
+			string path = m_data.completed.registeredFilePath.get();
+			DP_LOGD("registeredFilePath[%s]", path.c_str());
+			downloadItem->setRegisteredFilePath(path);
+			changed |= CHANGE::TITLE;
 		}
 		downloadItem->destroyHandle();
 		break;
 	case DA_CB::STOPPED:
-		if (m_error != URL_DOWNLOAD_ERROR_NONE) {
+		if (m_data.stopped.error != URL_DOWNLOAD_ERROR_NONE) {
 			downloadItem->setState(DL_ITEM::FAILED);
-			downloadItem->setErrorCode(downloadItem->_convert_error(m_error));
+			downloadItem->setErrorCode(
+				downloadItem->_convert_error(m_data.stopped.error));
+			changed |= CHANGE::ERROR;
 		} else {
 			downloadItem->setState(DL_ITEM::CANCELED);
 		}
@@ -150,22 +433,88 @@ void CbData::updateDownloadItem()
 	default:
 		break;
 	}
-	downloadItem->notify();
+	if (downloadItem->state() != oldState)
+		changed |= CHANGE::STATE;
+	downloadItem->notify(changed);
 }
 
-void __ecore_cb_pipe_update(void *data, void *buffer, unsigned int nbyte)
+void CbData::initData()
 {
-//	DP_LOGD_FUNC();
+	m_cbId = 0;
+	m_download_handle = NULL;
+	switch (m_type) {
+	case DA_CB::STARTED:
+		m_data.started.contentName.init();
+		m_data.started.mimeType.init();
+		break;
+	case DA_CB::COMPLETED:
+		m_data.completed.registeredFilePath.init();
+		break;
+	case DA_CB::STOPPED:
+		m_data.stopped.error = URL_DOWNLOAD_ERROR_NONE;
+		break;
+	default:
+		break;
+	}
+}
 
-	if (!buffer)
-		return;
-	pipe_data_t *pipe_data = static_cast<pipe_data_t *>(buffer);
-	CbData *cbData = pipe_data->cbData;
-	if (!cbData)
-		return;
+void CbData::reset()
+{
+	switch (m_type) {
+	case DA_CB::STARTED:
+		m_data.started.contentName.release();
+		m_data.started.mimeType.release();
+		break;
+	case DA_CB::COMPLETED:
+		m_data.completed.registeredFilePath.release();
+		break;
+	default:
+		break;
+	}
+	m_cbId = 0;
+	m_download_handle = NULL;
+}
 
-	cbData->updateDownloadItem();
-	delete cbData;
+Eina_Bool __cb_event_fd_handler(void *data, Ecore_Fd_Handler *fd_handler)
+{
+//	DP_LOGD_FUNC();
+	eventfd_t value = 0;
+
+	if (eventfd_read(cb_event_fd, &value) < 0)
+		DP_LOGD("No event to read");
+	cb_wakeup_count++;
+	/* Clear before draining. An event which is posted after this point
+	 * is drained now or wakes up the main loop again */
+	__sync_lock_release(&cb_wakeup_pending);
+	__sync_synchronize();
+
+	/* The events in the ring before the tail are older than the overflow
+	 * events. The lock is not held while the events are handled */
+	deque<CbData *> overflow;
+	pthread_mutex_lock(&cb_producer_mutex);
+	unsigned int tail = cb_ring_tail;
+	overflow.swap(cb_overflow);
+	pthread_mutex_unlock(&cb_producer_mutex);
+
+	unsigned int head = cb_ring_head;
+	while (head != tail) {
+		__sync_synchronize();
+		CbData *cbData = &cb_ring[head & DA_CB_RING_MASK];
+		cbData->updateDownloadItem();
+		cbData->reset();
+		head++;
+		cb_event_count++;
+		__sync_synchronize();
+		cb_ring_head = head;
+	}
+	while (!overflow.empty()) {
+		CbData *cbData = overflow.front();
+		overflow.pop_front();
+		cbData->updateDownloadItem();
+		delete cbData;
+		cb_event_count++;
+	}
+	return ECORE_CALLBACK_RENEW;
 }
 
 DownloadItem::DownloadItem()
@@ -175,6 +524,7 @@ DownloadItem::DownloadItem()
 	, m_receivedFileSize(0)
 	, m_fileSize(0)
 	, m_downloadType(DL_TYPE::HTTP_DOWNLOAD)
+	, m_cbId(0)
 {
 }
 
@@ -186,6 +536,7 @@ DownloadItem::DownloadItem(auto_ptr<DownloadRequest> request)
 	, m_receivedFileSize(0)
 	, m_fileSize(0)
 	, m_downloadType(DL_TYPE::HTTP_DOWNLOAD)
+	, m_cbId(0)
 {
 }
 
@@ -197,31 +548,35 @@ void DownloadItem::createHandle()
 		return;
 	}
 	DP_LOGD("URL download handle : [%p]", m_download_handle);
-	ret = url_download_set_started_cb(m_download_handle, started_cb, static_cast<void*>(this));
+	m_cbId = ++cb_next_id;
+	cb_items[m_cbId] = this;
+	__add_progress_slot(m_cbId);
+	void *userData = (void *)(uintptr_t)m_cbId;
+	ret = url_download_set_started_cb(m_download_handle, started_cb, userData);
 	if (ret != URL_DOWNLOAD_ERROR_NONE) {
 		DP_LOGE("Fail to set started callback : [%d]", ret);
 		return;
 	}
 
-	ret = url_download_set_completed_cb(m_download_handle, completed_cb, static_cast<void*>(this));
+	ret = url_download_set_completed_cb(m_download_handle, completed_cb, userData);
 	if (ret != URL_DOWNLOAD_ERROR_NONE) {
 		DP_LOGE("Fail to set completed cb : [%d]", ret);
 		return;
 	}
 
-	ret = url_download_set_paused_cb(m_download_handle, paused_cb, static_cast<void*>(this));
+	ret = url_download_set_paused_cb(m_download_handle, paused_cb, userData);
 	if (ret != URL_DOWNLOAD_ERROR_NONE) {
 		DP_LOGE("Fail to set paused cb : [%d]", ret);
 		return;
 	}
 
-	ret = url_download_set_stopped_cb(m_download_handle, stopped_cb, static_cast<void*>(this));
+	ret = url_download_set_stopped_cb(m_download_handle, stopped_cb, userData);
 	if (ret != URL_DOWNLOAD_ERROR_NONE) {
 		DP_LOGE("Fail to set stopped cb : [%d]", ret);
 		return;
 	}
 
-	ret = url_download_set_progress_cb(m_download_handle, progress_cb, static_cast<void*>(this));
+	ret = url_download_set_progress_cb(m_download_handle, progress_cb, userData);
 	if (ret != URL_DOWNLOAD_ERROR_NONE) {
 		DP_LOGE("Fail to set progress cb : [%d]", ret);
 		return;
@@ -268,6 +623,9 @@ void DownloadItem::destroyHandle()
 	url_download_unset_stopped_cb(m_download_handle);
 	url_download_unset_progress_cb(m_download_handle);
 	url_download_destroy(m_download_handle);
+	cb_items.erase(m_cbId);
+	__remove_progress_slot(m_cbId);
+	m_cbId = 0;
 	m_download_handle = NULL;
 }
 
@@ -275,7 +633,9 @@ void DownloadItem::started_cb(url_download_h download, const char *name,
 	const char *mime, void *user_data)
 {
 
-	CbData *cbData = new CbData();
+	CbData *cbData = __acquire_cb_data(false);
+	if (!cbData)
+		return;
 	cbData->setType(DA_CB::STARTED);
 	cbData->setDownloadHandle(download);
 	cbData->setUserData(user_data);
@@ -284,65 +644,75 @@ void DownloadItem::started_cb(url_download_h download, const char *name,
 	if (mime)
 		cbData->setMimeType(mime);
 
-	pipe_data_t pipe_data;
-	pipe_data.cbData = cbData;
-	ecore_pipe_write(ecore_pipe, &pipe_data, sizeof(pipe_data_t));
+	__post_cb_data();
 }
 
 void DownloadItem::paused_cb(url_download_h download, void *user_data)
 {
-	CbData *cbData = new CbData();
+	CbData *cbData = __acquire_cb_data(false);
+	if (!cbData)
+		return;
 	cbData->setType(DA_CB::PAUSED);
 	cbData->setDownloadHandle(download);
 	cbData->setUserData(user_data);
 
-	pipe_data_t pipe_data;
-	pipe_data.cbData = cbData;
-	ecore_pipe_write(ecore_pipe, &pipe_data, sizeof(pipe_data_t));
+	__post_cb_data();
 }
 
 void DownloadItem::completed_cb(url_download_h download, const char *path,
 	void *user_data)
 {
-	CbData *cbData = new CbData();
+	CbData *cbData = __acquire_cb_data(false);
+	if (!cbData)
+		return;
 	cbData->setType(DA_CB::COMPLETED);
 	cbData->setDownloadHandle(download);
 	cbData->setUserData(user_data);
 	cbData->setRegisteredFilePath(path);
 
-	pipe_data_t pipe_data;
-	pipe_data.cbData = cbData;
-	ecore_pipe_write(ecore_pipe, &pipe_data, sizeof(pipe_data_t));
+	__post_cb_data();
 }
 
 void DownloadItem::stopped_cb(url_download_h download, url_download_error_e error,
 	void *user_data)
 {
-	CbData *cbData = new CbData();
+	CbData *cbData = __acquire_cb_data(false);
+	if (!cbData)
+		return;
 	cbData->setType(DA_CB::STOPPED);
 	cbData->setDownloadHandle(download);
 	cbData->setUserData(user_data);
 	cbData->setErrorCode(error);
 
-	pipe_data_t pipe_data;
-	pipe_data.cbData = cbData;
-	ecore_pipe_write(ecore_pipe, &pipe_data, sizeof(pipe_data_t));
+	__post_cb_data();
 }
 
+/* Progress is not queued per callback.
+ * The latest value is kept at the slot of the callback id and one event is queued
+ * until the main loop takes it. The position of the event in the ring keeps
+ * the order with started, completed and stopped events.
+ * The download item is not touched at this thread */
 void DownloadItem::progress_cb(url_download_h download, unsigned long long received,
 	unsigned long long total, void *user_data)
 {
-	CbData *cbData = new CbData();
+	unsigned long cbId = (unsigned long)(uintptr_t)user_data;
+	if (!cbId)
+		return;
+	if (!__set_pending_progress(cbId, received, total)) {
+		__sync_fetch_and_add(&progress_coalesced_count, 1);
+		return;
+	}
+
+	CbData *cbData = __acquire_cb_data(true);
+	if (!cbData) {
+		__cancel_pending_progress(cbId);
+		return;
+	}
 	cbData->setType(DA_CB::PROGRESS);
 	cbData->setDownloadHandle(download);
 	cbData->setUserData(user_data);
-	cbData->setFileSize(total);
-	cbData->setReceivedFileSize(received);
 // need to tmp path??
-
-	pipe_data_t pipe_data;
-	pipe_data.cbData = cbData;
-	ecore_pipe_write(ecore_pipe, &pipe_data, sizeof(pipe_data_t));
+	__post_cb_data();
 }
 
 void DownloadItem::start(bool isRetry)
@@ -360,7 +730,7 @@ void DownloadItem::start(bool isRetry)
 		DP_LOGE("Fail to set url : [%d]", ret);
 		m_state = DL_ITEM::FAILED;
 		m_errorCode = ERROR::ENGINE_FAIL;
-		notify();
+		notify(CHANGE::STATE | CHANGE::ERROR);
 		return;
 	}
 	if (!m_aptr_request->getCookie().empty()) {
@@ -370,7 +740,7 @@ void DownloadItem::start(bool isRetry)
 			DP_LOGE("Fail to set cookie : [%d]", ret);
 			m_state = DL_ITEM::FAILED;
 			m_errorCode = ERROR::ENGINE_FAIL;
-			notify();
+			notify(CHANGE::STATE | CHANGE::ERROR);
 			return;
 		}
 	}
@@ -380,7 +750,7 @@ void DownloadItem::start(bool isRetry)
 	if (ret != URL_DOWNLOAD_ERROR_NONE) {
 		m_state = DL_ITEM::FAILED;
 		m_errorCode = ERROR::ENGINE_FAIL;
-		notify();
+		notify(CHANGE::STATE | CHANGE::ERROR);
 	}
 }
 
@@ -422,7 +792,7 @@ void DownloadItem::cancel()
 	DP_LOGD("DownloadItem::cancel");
 	if (m_state == DL_ITEM::CANCELED) {
 		DP_LOGD("It is already canceled");
-		notify();
+		notify(CHANGE::STATE);
 		return;
 	}
 	int ret = url_download_stop(m_download_handle);
@@ -431,7 +801,7 @@ void DownloadItem::cancel()
 			m_download_handle, ret);
 		m_state = DL_ITEM::FAILED;
 		m_errorCode = ERROR::ENGINE_FAIL;
-		notify();
+		notify(CHANGE::STATE | CHANGE::ERROR);
 	}
 	return;
 }
@@ -456,7 +826,7 @@ void DownloadItem::suspend()
 			m_download_handle, ret);
 		m_state = DL_ITEM::FAILED;
 		m_errorCode = ERROR::ENGINE_FAIL;
-		notify();
+		notify(CHANGE::STATE | CHANGE::ERROR);
 	}
 }
 
@@ -468,6 +838,6 @@ void DownloadItem::resume()
 			m_download_handle, ret);
 		m_state = DL_ITEM::FAILED;
 		m_errorCode = ERROR::ENGINE_FAIL;
-		notify();
+		notify(CHANGE::STATE | CHANGE::ERROR);
 	}
 }
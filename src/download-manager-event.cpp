@@ -22,45 +22,98 @@
 #include "download-manager-event.h"
 #include "download-manager-common.h"
 
+#include "download-manager-slab.h"
+
 #include <iostream>
+#include <new>
+
+static SlabAllocator observerSlab("Observer", sizeof(Observer), SLAB_OBJS_PER_PAGE);
+
+void *Observer::operator new(size_t size)
+{
+	void *p = observerSlab.alloc(size);
+	if (!p)
+		throw bad_alloc();
+	return p;
+}
+
+void Observer::operator delete(void *p)
+{
+	observerSlab.free(p);
+}
+
+Subject::Subject()
+	: m_head(NULL)
+	, m_tail(NULL)
+	, m_cursor(NULL)
+{
+}
+
+Subject::~Subject()
+{
+	while (m_head)
+		detach(m_head);
+}
 
 void Subject::attach(Observer *o)
 {
-	_observers.push_back(o);
+	if (o->m_subject == this)
+		return;
+	if (o->m_subject)
+		o->m_subject->detach(o);
+	o->m_subject = this;
+	o->m_prev = m_tail;
+	o->m_next = NULL;
+	if (m_tail)
+		m_tail->m_next = o;
+	else
+		m_head = o;
+	m_tail = o;
 }
 
 void Subject::detach(Observer *o)
 {
-	vector<Observer*>::iterator it;
-	for(it = _observers.begin() ; it < _observers.end() ; it++) {
-		if (*it == o) {
-			_observers.erase(it);
-			break;
-		}
+	if (o->m_subject != this)
+		return;
+	/* Skip the observer at the running notify() */
+	for (NotifyCursor *c = m_cursor; c; c = c->outer) {
+		if (c->next == o)
+			c->next = o->m_next;
 	}
+	if (o->m_prev)
+		o->m_prev->m_next = o->m_next;
+	else
+		m_head = o->m_next;
+	if (o->m_next)
+		o->m_next->m_prev = o->m_prev;
+	else
+		m_tail = o->m_prev;
+	o->m_subject = NULL;
+	o->m_prev = NULL;
+	o->m_next = NULL;
 }
 
-void Subject::notify(void)
+void Subject::notify(unsigned int changed)
 {
-	vector<Observer*>::iterator it;
+	NotifyCursor cursor;
 	Observer *curObserver;
-	it = _observers.begin();
-	while (it < _observers.end()) {
-		curObserver = *it;
 
-		DP_LOGD("[%s] Call Update",curObserver->name().c_str());
-		(*it)->update(this);
+	cursor.next = m_head;
+	cursor.outer = m_cursor;
+	m_cursor = &cursor;
+	while (cursor.next) {
+		curObserver = cursor.next;
+		cursor.next = curObserver->m_next;
 
-		if (curObserver != *it)
-			continue;
-
-		it++;
+		DP_LOGD("[%s] Call Update", curObserver->name());
+		curObserver->update(this, changed);
 	}
+	m_cursor = cursor.outer;
 }
 
-void Observer::update(Subject *s)
+void Observer::update(Subject *s, unsigned int changed)
 {
-	call();
+	call(changed);
 }
 
 //Observer::Observer(updateFunction uf, void *data)
@@ -68,8 +121,17 @@ void Observer::update(Subject *s)
 Observer::Observer(updateFunction uf, void *data, const char *name)
 	: m_updateFunction(uf)
 	, m_userData(data)
+	, observerName(name)
+	, m_subject(NULL)
+	, m_prev(NULL)
+	, m_next(NULL)
+{
+}
+
+Observer::~Observer()
 {
-	observerName = name;
+	if (m_subject)
+		m_subject->detach(this);
 }
 
 void Observer::set(updateFunction uf, void *data)
@@ -84,8 +146,8 @@ void Observer::clear(void)
 	m_userData = 0;
 }
 
-void Observer::call(void)
+void Observer::call(unsigned int changed)
 {
 	if (m_updateFunction)
-		m_updateFunction(m_userData);
+		m_updateFunction(m_userData, changed);
 }
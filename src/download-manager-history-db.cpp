@@ -21,300 +21,913 @@
  */
 
 #include <sstream>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "download-manager-common.h"
 #include "download-manager-history-db.h"
+#include "download-manager-items.h"
 
-#define FINALIZE_ON_ERROR( stmt ) { \
-	DP_LOG("SQL error: %d", ret);\
-	if (sqlite3_finalize(stmt) != SQLITE_OK)\
-		DP_LOGE("sqlite3_finalize is failed.");\
-	close();\
-	return false; \
+/* The reader and the writer thread use their own connection.
+ * Wait for the lock of the other one instead of failing with SQLITE_BUSY */
+#define HISTORY_DB_BUSY_TIMEOUT 3000
+/* The WAL file is checkpointed from an idle time of the main loop
+ * when it grows over this instead of sqlite's auto checkpoint at commit */
+#define HISTORY_DB_CHECKPOINT_PAGES 200
+/* Pages which the reader thread reads ahead of the view */
+#define HISTORY_READ_BATCHES 2
+/* A page which cannot be read, e.g. by SQLITE_BUSY, is read again from the
+ * same position after the delay. The load fails after the retries */
+#define HISTORY_READ_RETRY 3
+#define HISTORY_READ_RETRY_DELAY 100000
+/* A batch which cannot be committed is written again after the delay.
+ * It is dropped after the retries */
+#define HISTORY_DB_WRITE_RETRY 3
+#define HISTORY_DB_WRITE_RETRY_DELAY 100000
+
+struct HistoryMigration {
+	int version;
+	const char *query;
+};
+
+/* Schema changes are appended here and applied in order by migrate().
+ * Never change an entry after it is released. */
+static const HistoryMigration historyMigrations[] = {
+	/* The base schema which is also created by the package script */
+	{1, "create table if not exists history(id integer primary key \
+		autoincrement, historyid integer, downloadtype integer, \
+		contenttype integer, state integer, err integer, name, path, url, \
+		cookie, date datetime);"},
+	/* createItemsFromHistoryDB sorts by date and deleteItem looks up by
+	 * historyid */
+	{2, "create index if not exists history_date_idx on history(date); \
+		create index if not exists history_historyid_idx on \
+		history(historyid);"},
+	/* History ids are allocated in order from next_history_id.
+	 * It starts after the ids which were made from time or rand */
+	{3, "insert or ignore into history_meta (key, value) \
+		select 'next_history_id', ifnull(max(historyid), 0) + 1 \
+		from history;"},
+};
+
+HistoryCursor::HistoryCursor()
+	: m_lastDate(0)
+	, m_lastId(0)
+	, m_isStarted(false)
+	, m_isEnd(false)
+{
 }
 
-sqlite3 *DownloadHistoryDB::historyDb = NULL;
+bool HistoryCursor::loadNext(int limit)
+{
+	return DownloadHistoryDB::createItemsFromHistoryDB(*this, limit);
+}
 
-DownloadHistoryDB::DownloadHistoryDB()
+void HistoryCursor::moveTo(double date, int id)
 {
+	m_lastDate = date;
+	m_lastId = id;
+	m_isStarted = true;
 }
 
-DownloadHistoryDB::~DownloadHistoryDB()
+HistoryDBConnection::HistoryDBConnection()
+	: m_db(NULL)
 {
 }
 
-bool DownloadHistoryDB::open()
+HistoryDBConnection::~HistoryDBConnection()
+{
+}
+
+bool HistoryDBConnection::open()
 {
 	int ret = 0;
 
-	DP_LOGD_FUNC();
+	if (isOpen())
+		return true;
 
-	close();
+	DP_LOGD_FUNC();
 
-	ret = db_util_open(DBDATADIR"/"HISTORYDB, &historyDb,
+	ret = db_util_open(DBDATADIR"/"HISTORYDB, &m_db,
 		DB_UTIL_REGISTER_HOOK_METHOD);
 
 	if (ret != SQLITE_OK) {
 		DP_LOGE("open fail");
-		db_util_close(historyDb);
-		historyDb = NULL;
+		db_util_close(m_db);
+		m_db = NULL;
 		return false;
 	}
+	if (sqlite3_busy_timeout(m_db, HISTORY_DB_BUSY_TIMEOUT) != SQLITE_OK)
+		DP_LOGE("sqlite3_busy_timeout is failed.");
 
 	return isOpen();
 }
 
-void DownloadHistoryDB::close()
+void HistoryDBConnection::close()
 {
 	DP_LOGD_FUNC();
-	if (historyDb) {
-		db_util_close(historyDb);
-		historyDb = NULL;
+	finalizeStatements();
+	if (m_db) {
+		db_util_close(m_db);
+		m_db = NULL;
 	}
 }
 
-/* FIXME : Hitory entry limitation ?? */
-bool DownloadHistoryDB::addToHistoryDB(Item *item)
+bool HistoryDBConnection::execSQL(const char *query)
 {
 	int ret = 0;
-	sqlite3_stmt *stmt = NULL;
-
-	DP_LOG_FUNC();
+	char *errmsg = NULL;
 
-	if (!item) {
-		DP_LOGE("Item is NULL");
+	if (!open()) {
+		DP_LOGE("historyDB is NULL");
 		return false;
 	}
 
-	if (item->historyId() < 0) {
-		DP_LOGE("Cannot add to DB. Because historyId is invaild");
+	ret = sqlite3_exec(m_db, query, NULL, NULL, &errmsg);
+	if (ret != SQLITE_OK) {
+		DP_LOGE("SQL error: %d [%s]", ret, errmsg ? errmsg : "");
+		sqlite3_free(errmsg);
 		return false;
 	}
+	return true;
+}
+
+sqlite3_stmt *HistoryDBConnection::getStatement(const char *query)
+{
+	int ret = 0;
+	sqlite3_stmt *stmt = NULL;
+	map<string, sqlite3_stmt *>::iterator it;
 
 	if (!open()) {
 		DP_LOGE("historyDB is NULL");
-		return false;
+		return NULL;
 	}
 
-	const string statement = "insert into history (historyid, downloadtype,\
-		contenttype, state, err, name, path, url, cookie, date) \
-		values(?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+	it = m_stmtCache.find(query);
+	if (it != m_stmtCache.end())
+		return it->second;
 
-	ret = sqlite3_prepare_v2(historyDb, statement.c_str(), -1, &stmt, NULL);
+	ret = sqlite3_prepare_v2(m_db, query, -1, &stmt, NULL);
+	if (ret != SQLITE_OK) {
+		DP_LOGE("Fail to prepare [%s] : %d", query, ret);
+		if (sqlite3_finalize(stmt) != SQLITE_OK)
+			DP_LOGE("sqlite3_finalize is failed.");
+		return NULL;
+	}
+	m_stmtCache[query] = stmt;
+	return stmt;
+}
 
-	if (ret != SQLITE_OK)
-		FINALIZE_ON_ERROR(stmt);
-	/* binding values */
-	if (sqlite3_bind_int(stmt, 1, item->historyId()) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_int is failed.");
-	if (sqlite3_bind_int(stmt, 2, item->downloadType()) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_int is failed.");
-	if (sqlite3_bind_int(stmt, 3, item->contentType()) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_int is failed.");
-	if (sqlite3_bind_int(stmt, 4, item->state()) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_int is failed.");
-	if (sqlite3_bind_int(stmt, 5, item->errorCode()) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_int is failed.");
-	if (sqlite3_bind_text(stmt, 6, item->title().c_str(), -1, NULL) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_text is failed.");
-	if (sqlite3_bind_text(
-			stmt, 7, item->registeredFilePath().c_str(), -1, NULL) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_text is failed.");
-	if (sqlite3_bind_text(stmt, 8, item->url().c_str(), -1, NULL) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_text is failed.");
-	if (sqlite3_bind_text(stmt, 9, item->cookie().c_str(), -1, NULL) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_text is failed.");
-	if (sqlite3_bind_double(stmt, 10, item->finishedTime()) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_double is failed.");
-	ret = sqlite3_step(stmt);
+/* Reset a cached statement after use.
+ * Otherwise a read statement keeps the read transaction open */
+void HistoryDBConnection::releaseStatement(sqlite3_stmt *stmt)
+{
+	if (!stmt)
+		return;
+	sqlite3_reset(stmt);
+	if (sqlite3_clear_bindings(stmt) != SQLITE_OK)
+		DP_LOGE("sqlite3_clear_bindings is failed.");
+}
 
-	DP_LOGD("SQL return: %s", (ret == SQLITE_ROW || ret == SQLITE_OK)?"Success":"Fail");
+void HistoryDBConnection::finalizeStatements()
+{
+	map<string, sqlite3_stmt *>::iterator it;
+	for (it = m_stmtCache.begin(); it != m_stmtCache.end(); it++) {
+		if (sqlite3_finalize(it->second) != SQLITE_OK)
+			DP_LOGE("sqlite3_finalize is failed.");
+	}
+	m_stmtCache.clear();
+}
 
-	close();
+HistoryDBConnection DownloadHistoryDB::historyDb;
+HistoryDBConnection DownloadHistoryDB::writerDb;
+pthread_t DownloadHistoryDB::writerThread;
+pthread_mutex_t DownloadHistoryDB::writerMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t DownloadHistoryDB::writerCond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t DownloadHistoryDB::flushCond = PTHREAD_COND_INITIALIZER;
+deque<HistoryOp *> DownloadHistoryDB::pendingOps;
+bool DownloadHistoryDB::isWriterRunning = false;
+bool DownloadHistoryDB::isWriting = false;
+unsigned long DownloadHistoryDB::queuedCount = 0;
+unsigned long DownloadHistoryDB::committedCount = 0;
+#ifdef _HISTORY_DB_FAST
+HISTORY_DB::DURABILITY DownloadHistoryDB::durability =
+	HISTORY_DB::DURABILITY_FAST;
+#else
+HISTORY_DB::DURABILITY DownloadHistoryDB::durability =
+	HISTORY_DB::DURABILITY_DEFAULT;
+#endif
+Ecore_Idle_Enterer *DownloadHistoryDB::checkpointIdleEnterer = NULL;
+int DownloadHistoryDB::walPages = 0;
+bool DownloadHistoryDB::isWalCommitted = false;
+bool DownloadHistoryDB::isCheckpointQueued = false;
+unsigned long long DownloadHistoryDB::nextHistoryId = 0;
+HistoryDBConnection DownloadHistoryDB::readerDb;
+pthread_t DownloadHistoryDB::readerThread;
+pthread_mutex_t DownloadHistoryDB::readerMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t DownloadHistoryDB::readerCond = PTHREAD_COND_INITIALIZER;
+deque<vector<HistoryRow> *> DownloadHistoryDB::readBatches;
+bool DownloadHistoryDB::isReaderRunning = false;
+bool DownloadHistoryDB::isReadDone = false;
+bool DownloadHistoryDB::isReadFailed = false;
+int DownloadHistoryDB::readerEventFd = -1;
+Ecore_Fd_Handler *DownloadHistoryDB::readerFdHandler = NULL;
+HistoryReadCB DownloadHistoryDB::readerCB = NULL;
+void *DownloadHistoryDB::readerCBData = NULL;
 
-	return ret == SQLITE_DONE;
+DownloadHistoryDB::DownloadHistoryDB()
+{
 }
 
-bool DownloadHistoryDB::getCountOfHistory(int *count)
+DownloadHistoryDB::~DownloadHistoryDB()
 {
-	int ret = 0;
-	sqlite3_stmt *stmt = NULL;
+}
 
+/* The connection is opened once when the application is created
+ * and kept until it is terminated.
+ * History changes are written by the writer thread */
+bool DownloadHistoryDB::initDB()
+{
 	DP_LOG_FUNC();
+	if (!open())
+		return false;
+	if (!startWriter())
+		DP_LOGE("Fail to start writer thread. History is written synchronously");
+	if (!checkpointIdleEnterer)
+		checkpointIdleEnterer = ecore_idle_enterer_add(
+			checkpointIdleEntererCB, NULL);
+	return true;
+}
 
-	if (!open()) {
-		DP_LOGE("historyDB is NULL");
+void DownloadHistoryDB::deinitDB()
+{
+	DP_LOG_FUNC();
+	if (checkpointIdleEnterer) {
+		ecore_idle_enterer_del(checkpointIdleEnterer);
+		checkpointIdleEnterer = NULL;
+	}
+	stopReader();
+	flush();
+	stopWriter();
+	DP_LOG("history writes queued[%lu] committed[%lu]",
+		queuedWriteCount(), committedWriteCount());
+	close();
+}
+
+bool DownloadHistoryDB::open()
+{
+	if (historyDb.isOpen())
+		return true;
+
+	if (!historyDb.open())
+		return false;
+
+	if (!applyDurability(historyDb))
+		DP_LOGE("Fail to set durability of history DB");
+
+	if (!migrate(historyDb)) {
+		DP_LOGE("Fail to migrate history DB");
+		historyDb.close();
 		return false;
 	}
-	ret = sqlite3_prepare_v2(historyDb, "select COUNT(*) from history", -1, &stmt, NULL);
-	if (ret != SQLITE_OK)
-		FINALIZE_ON_ERROR(stmt);
+	loadNextHistoryId();
 
-	ret = sqlite3_step(stmt);
-	DP_LOGD("SQL return: %s", (ret == SQLITE_ROW || ret == SQLITE_OK)?"Success":"Fail");
-	if (ret == SQLITE_ROW) {
-		*count = sqlite3_column_int(stmt,0);
-		DP_LOGD("count[%d]",*count);
-	} else {
-		DP_LOGE("SQL query error");
-		*count = 0;
+	return true;
+}
+
+void DownloadHistoryDB::loadNextHistoryId()
+{
+	sqlite3_stmt *stmt = NULL;
+
+	stmt = historyDb.getStatement("select value from history_meta \
+		where key='next_history_id'");
+	if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+		nextHistoryId = sqlite3_column_int64(stmt, 0);
+	historyDb.releaseStatement(stmt);
+	DP_LOGD("next history id[%llu]", nextHistoryId);
+}
+
+/* History ids are increased monotonically.
+ * The next id is saved to DB together with the history item */
+unsigned long long DownloadHistoryDB::createHistoryId()
+{
+	if (nextHistoryId == 0) {
+		DP_LOGE("next history id is not loaded");
+		nextHistoryId = time(NULL);
 	}
+	return nextHistoryId++;
+}
 
+void DownloadHistoryDB::close()
+{
+	DP_LOGD_FUNC();
+	historyDb.close();
+	writerDb.close();
+}
+
+int DownloadHistoryDB::getSchemaVersion(HistoryDBConnection &conn)
+{
+	int ret = 0;
+	int version = 0;
+	sqlite3_stmt *stmt = NULL;
+
+	ret = sqlite3_prepare_v2(conn.handle(),
+		"select value from history_meta where key='schema_version'",
+		-1, &stmt, NULL);
+	if (ret != SQLITE_OK) {
+		DP_LOGE("Fail to get schema version : %d", ret);
+		sqlite3_finalize(stmt);
+		return -1;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		version = sqlite3_column_int(stmt, 0);
 	if (sqlite3_finalize(stmt) != SQLITE_OK)
 		DP_LOGE("sqlite3_finalize is failed.");
-	close();
-	return true;
+	return version;
 }
 
-bool DownloadHistoryDB::createRemainedItemsFromHistoryDB(int limit, int offset)
+bool DownloadHistoryDB::setSchemaVersion(HistoryDBConnection &conn,
+	int version)
 {
 	int ret = 0;
-	stringstream limitStr;
-	stringstream offsetStr;
 	sqlite3_stmt *stmt = NULL;
-	string tmp;
 
-	DP_LOG_FUNC();
+	ret = sqlite3_prepare_v2(conn.handle(), "insert or replace into \
+		history_meta (key, value) values('schema_version', ?)",
+		-1, &stmt, NULL);
+	if (ret != SQLITE_OK) {
+		DP_LOGE("Fail to set schema version : %d", ret);
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	if (sqlite3_bind_int(stmt, 1, version) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int is failed.");
+	ret = sqlite3_step(stmt);
+	if (sqlite3_finalize(stmt) != SQLITE_OK)
+		DP_LOGE("sqlite3_finalize is failed.");
+	return ret == SQLITE_DONE;
+}
 
-	if (!open()) {
-		DP_LOGE("historyDB is NULL");
+/* Bring the schema up to the latest version.
+ * Each step runs in its own transaction together with the version update */
+bool DownloadHistoryDB::migrate(HistoryDBConnection &conn)
+{
+	int version = 0;
+	unsigned int i = 0;
+
+	if (!conn.execSQL("create table if not exists history_meta(\
+			key text primary key, value);"))
+		return false;
+
+	version = getSchemaVersion(conn);
+	if (version < 0)
+		return false;
+
+	for (i = 0; i < sizeof(historyMigrations) / sizeof(historyMigrations[0]);
+			i++) {
+		const HistoryMigration &m = historyMigrations[i];
+		if (m.version <= version)
+			continue;
+		DP_LOG("Migrate history DB [%d] -> [%d]", version, m.version);
+		if (!conn.execSQL("begin immediate transaction;"))
+			return false;
+		if (!conn.execSQL(m.query) || !setSchemaVersion(conn, m.version)) {
+			conn.execSQL("rollback transaction;");
+			return false;
+		}
+		if (!conn.execSQL("commit transaction;")) {
+			conn.execSQL("rollback transaction;");
+			return false;
+		}
+		version = m.version;
+	}
+	return true;
+}
+
+/* WAL lets the reader load history while the writer commits.
+ * The journal mode is persistent, synchronous is per connection */
+bool DownloadHistoryDB::applyDurability(HistoryDBConnection &conn)
+{
+	DP_LOGD("durability[%d]", durability);
+	switch (durability) {
+	case HISTORY_DB::DURABILITY_FAST:
+		return conn.execSQL("PRAGMA journal_mode=WAL; \
+			PRAGMA synchronous=OFF; PRAGMA temp_store=memory;");
+	case HISTORY_DB::DURABILITY_DEFAULT:
+	default:
+		return conn.execSQL("PRAGMA journal_mode=WAL; \
+			PRAGMA synchronous=NORMAL;");
+	}
+}
+
+bool DownloadHistoryDB::openWriter()
+{
+	if (writerDb.isOpen())
+		return true;
+	if (!writerDb.open())
 		return false;
+	if (!applyDurability(writerDb))
+		DP_LOGE("Fail to set durability of history DB");
+	/* This also disables the auto checkpoint */
+	sqlite3_wal_hook(writerDb.handle(), walHookCB, NULL);
+	return true;
+}
+
+/* This is called at the writer thread after each commit */
+int DownloadHistoryDB::walHookCB(void *data, sqlite3 *db, const char *dbName,
+	int pages)
+{
+	pthread_mutex_lock(&writerMutex);
+	walPages = pages;
+	isWalCommitted = true;
+	pthread_mutex_unlock(&writerMutex);
+	return SQLITE_OK;
+}
+
+Eina_Bool DownloadHistoryDB::checkpointIdleEntererCB(void *data)
+{
+	bool needCheckpoint = false;
+	int pages = 0;
+
+	pthread_mutex_lock(&writerMutex);
+	if (!isCheckpointQueued && isWalCommitted &&
+			walPages >= HISTORY_DB_CHECKPOINT_PAGES) {
+		isCheckpointQueued = true;
+		isWalCommitted = false;
+		needCheckpoint = true;
+		pages = walPages;
 	}
-	limitStr << limit;
-	offsetStr << offset;
+	pthread_mutex_unlock(&writerMutex);
 
-	tmp.append("select historyid, downloadtype, contenttype, state, err, ");
-	tmp.append("name, path, url, cookie, date from history order by ");
-	tmp.append("date DESC limit ");
-	tmp.append(limitStr.str());
-	tmp.append(" offset ");
-	tmp.append(offsetStr.str());
-	ret = sqlite3_prepare_v2(historyDb, tmp.c_str(), -1, &stmt, NULL);
-	if (ret != SQLITE_OK)
-		FINALIZE_ON_ERROR(stmt);
+	if (needCheckpoint) {
+		DP_LOGD("Request checkpoint. WAL pages[%d]", pages);
+		HistoryOp *op = new HistoryOp();
+		op->type = HISTORY_OP::CHECKPOINT;
+		pushOp(op);
+	}
+	return ECORE_CALLBACK_RENEW;
+}
+
+/* Passive checkpoint doesn't wait for readers.
+ * Pages which are still used by a reader are copied at the next time */
+bool DownloadHistoryDB::checkpoint()
+{
+	int ret = 0;
+	int logPages = 0;
+	int checkpointedPages = 0;
+
+	ret = sqlite3_wal_checkpoint_v2(writerDb.handle(), NULL,
+		SQLITE_CHECKPOINT_PASSIVE, &logPages, &checkpointedPages);
+	DP_LOGD("checkpoint ret[%d] log[%d] checkpointed[%d]", ret, logPages,
+		checkpointedPages);
+
+	pthread_mutex_lock(&writerMutex);
+	if (ret == SQLITE_OK)
+		walPages = logPages - checkpointedPages;
+	isCheckpointQueued = false;
+	pthread_mutex_unlock(&writerMutex);
+	return ret == SQLITE_OK;
+}
 
+bool DownloadHistoryDB::startWriter()
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&writerMutex);
+	if (isWriterRunning) {
+		pthread_mutex_unlock(&writerMutex);
+		return true;
+	}
+	isWriterRunning = true;
+	pthread_mutex_unlock(&writerMutex);
+
+	ret = pthread_create(&writerThread, NULL, writerThreadMain, NULL);
+	if (ret != 0) {
+		DP_LOGE("Fail to create writer thread : %d", ret);
+		pthread_mutex_lock(&writerMutex);
+		isWriterRunning = false;
+		pthread_mutex_unlock(&writerMutex);
+		return false;
+	}
+	return true;
+}
+
+void DownloadHistoryDB::stopWriter()
+{
+	pthread_mutex_lock(&writerMutex);
+	if (!isWriterRunning) {
+		pthread_mutex_unlock(&writerMutex);
+		return;
+	}
+	isWriterRunning = false;
+	pthread_cond_signal(&writerCond);
+	pthread_mutex_unlock(&writerMutex);
+
+	pthread_join(writerThread, NULL);
+}
+
+/* Wait until all queued history changes are committed */
+void DownloadHistoryDB::flush()
+{
+	DP_LOGD_FUNC();
+	pthread_mutex_lock(&writerMutex);
+	while (isWriterRunning && (!pendingOps.empty() || isWriting))
+		pthread_cond_wait(&flushCond, &writerMutex);
+	pthread_mutex_unlock(&writerMutex);
+}
+
+unsigned long DownloadHistoryDB::queuedWriteCount()
+{
+	unsigned long count = 0;
+	pthread_mutex_lock(&writerMutex);
+	count = queuedCount;
+	pthread_mutex_unlock(&writerMutex);
+	return count;
+}
+
+unsigned long DownloadHistoryDB::committedWriteCount()
+{
+	unsigned long count = 0;
+	pthread_mutex_lock(&writerMutex);
+	count = committedCount;
+	pthread_mutex_unlock(&writerMutex);
+	return count;
+}
+
+/* Every change which is queued while the previous batch is written
+ * is committed together in the next transaction */
+void *DownloadHistoryDB::writerThreadMain(void *data)
+{
+	deque<HistoryOp *> ops;
+	unsigned long committed = 0;
+	int retryCount = 0;
+	bool isRetry = false;
+
+	DP_LOG_FUNC();
+
+	pthread_mutex_lock(&writerMutex);
 	for (;;) {
-		ret = sqlite3_step(stmt);
-		if (ret == SQLITE_ROW) {
-			const char *tempStr = NULL;
-			string arg;
-			string url;
-			string cookie;
-			Item *item = Item::createHistoryItem();
-			if (!item) {
-				DP_LOGE("Fail to create item");
-				break;
+		while (isWriterRunning && pendingOps.empty())
+			pthread_cond_wait(&writerCond, &writerMutex);
+		if (pendingOps.empty())
+			break;
+		ops.swap(pendingOps);
+		isWriting = true;
+		pthread_mutex_unlock(&writerMutex);
+
+		committed = 0;
+		isRetry = false;
+		if (!writeOps(ops, &committed)) {
+			if (retryCount < HISTORY_DB_WRITE_RETRY) {
+				retryCount++;
+				isRetry = true;
+				DP_LOGE("Fail to commit history ops[%d] retry[%d]",
+					(int)ops.size(), retryCount);
+			} else {
+				DP_LOGE("Drop history ops[%d]", (int)ops.size());
+				dropOps(ops);
 			}
-			item->setHistoryId(sqlite3_column_int(stmt,0));
-			item->setDownloadType((DL_TYPE::TYPE)sqlite3_column_int(stmt,1));
-			item->setContentType(sqlite3_column_int(stmt,2));
-			item->setState((ITEM::STATE)sqlite3_column_int(stmt,3));
-			item->setErrorCode((ERROR::CODE)sqlite3_column_int(stmt,4));
-			tempStr = (const char *)(sqlite3_column_text(stmt,5));
-			if (tempStr)
-				arg = tempStr;
-			else
-				arg = string();
-			item->setTitle(arg);
-			tempStr = (const char *)(sqlite3_column_text(stmt,6));
-			if (tempStr)
-				arg = tempStr;
-			else
-				arg = string();
-			item->setRegisteredFilePath(arg);
-			tempStr = (const char *)(sqlite3_column_text(stmt,7));
-			if (tempStr)
-				url = tempStr;
-			else
-				url = string();
-			tempStr = (const char *)(sqlite3_column_text(stmt,8));
-			if (tempStr)
-				cookie = tempStr;
+		}
+		if (!isRetry)
+			retryCount = 0;
+
+		pthread_mutex_lock(&writerMutex);
+		committedCount += committed;
+		/* Put the batch back in front of the changes which are queued
+		 * while it is written to keep the order */
+		while (!ops.empty()) {
+			if (isRetry)
+				pendingOps.push_front(ops.back());
 			else
-				cookie = string();
-			item->setFinishedTime(sqlite3_column_double(stmt,9));
-			item->attachHistoryItem();
-			item->setRetryData(url, cookie);
-		} else
-			break;
+				delete ops.back();
+			ops.pop_back();
+		}
+		isWriting = false;
+		pthread_cond_broadcast(&flushCond);
+		if (isRetry) {
+			pthread_mutex_unlock(&writerMutex);
+			usleep(HISTORY_DB_WRITE_RETRY_DELAY);
+			pthread_mutex_lock(&writerMutex);
+		}
 	}
-	DP_LOGD("SQL error: %d", ret);
+	pthread_mutex_unlock(&writerMutex);
 
-	if (sqlite3_finalize(stmt) != SQLITE_OK)
-		DP_LOGE("sqlite3_finalize is failed.");
+	writerDb.close();
+	return NULL;
+}
 
-	close();
+bool DownloadHistoryDB::pushOp(HistoryOp *op)
+{
+	bool ret = true;
+	unsigned long committed = 0;
+	/* Checkpoint is not a history change */
+	bool isCheckpoint = (op->type == HISTORY_OP::CHECKPOINT);
 
-	if (ret == SQLITE_DONE || ret == SQLITE_ROW)
+	pthread_mutex_lock(&writerMutex);
+	if (!isCheckpoint)
+		queuedCount++;
+	if (isWriterRunning) {
+		pendingOps.push_back(op);
+		pthread_cond_signal(&writerCond);
+		pthread_mutex_unlock(&writerMutex);
 		return true;
-	else
+	}
+	pthread_mutex_unlock(&writerMutex);
+
+	/* There is no writer thread. Write it at the caller */
+	deque<HistoryOp *> ops;
+	ops.push_back(op);
+	ret = writeOps(ops, &committed);
+	pthread_mutex_lock(&writerMutex);
+	committedCount += committed;
+	pthread_mutex_unlock(&writerMutex);
+	if (!ret)
+		dropOps(ops);
+	delete op;
+	return ret && (committed > 0 || isCheckpoint);
+}
+
+/* Called when the changes cannot be written. They are lost */
+void DownloadHistoryDB::dropOps(deque<HistoryOp *> &ops)
+{
+	deque<HistoryOp *>::iterator it;
+	for (it = ops.begin(); it != ops.end(); it++) {
+		if ((*it)->type == HISTORY_OP::CHECKPOINT)
+			continue;
+		DP_LOGE("Drop history op[%d] historyId[%llu] ids[%d]", (*it)->type,
+			(*it)->historyId, (int)(*it)->ids.size());
+	}
+}
+
+/* Write the batch in one transaction.
+ * A failed change doesn't cancel other changes of the batch.
+ * committed is the count of changes which are committed.
+ * Checkpoint is not counted, because it doesn't change history.
+ * Return false if the transaction cannot be committed. Nothing is written */
+bool DownloadHistoryDB::writeOps(deque<HistoryOp *> &ops,
+	unsigned long *committed)
+{
+	deque<HistoryOp *>::iterator it;
+	bool needCheckpoint = false;
+	bool isApplied = false;
+	unsigned long applied = 0;
+
+	DP_LOGD("write history ops[%d]", (int)ops.size());
+
+	if (!openWriter())
+		return false;
+
+	if (!writerDb.execSQL("begin immediate transaction;"))
+		return false;
+
+	for (it = ops.begin(); it != ops.end(); it++) {
+		/* Checkpoint cannot run in a transaction */
+		if ((*it)->type == HISTORY_OP::CHECKPOINT) {
+			needCheckpoint = true;
+			continue;
+		}
+		if (!applyOpInSavepoint(*it, &isApplied)) {
+			writerDb.execSQL("rollback transaction;");
+			return false;
+		}
+		if (isApplied)
+			applied++;
+	}
+
+	if (!writerDb.execSQL("commit transaction;")) {
+		writerDb.execSQL("rollback transaction;");
+		return false;
+	}
+	*committed = applied;
+
+	if (needCheckpoint)
+		checkpoint();
+	return true;
+}
+
+/* A change is applied in its own savepoint.
+ * If it fails, only its own statements are rolled back.
+ * Return false if the savepoint cannot be handled */
+bool DownloadHistoryDB::applyOpInSavepoint(HistoryOp *op, bool *isApplied)
+{
+	*isApplied = false;
+	if (!writerDb.execSQL("savepoint history_op;"))
+		return false;
+	if (applyOp(op)) {
+		*isApplied = true;
+		return writerDb.execSQL("release history_op;");
+	}
+	DP_LOGE("Fail to write history op[%d] historyId[%llu]", op->type,
+		op->historyId);
+	if (!writerDb.execSQL("rollback to history_op;"))
+		return false;
+	return writerDb.execSQL("release history_op;");
+}
+
+bool DownloadHistoryDB::applyOp(HistoryOp *op)
+{
+	switch (op->type) {
+	case HISTORY_OP::INSERT:
+		return applyInsert(op);
+	case HISTORY_OP::DELETE:
+		return applyDelete(op);
+	case HISTORY_OP::DELETE_MULTIPLE:
+		return applyDeleteMultiple(op);
+	case HISTORY_OP::CLEAR:
+		return applyClear(op);
+	case HISTORY_OP::CHECKPOINT:
+		return checkpoint();
+	default:
+		DP_LOGE("Cannot enter here");
+		return false;
+	}
+}
+
+/* FIXME : Hitory entry limitation ?? */
+bool DownloadHistoryDB::addToHistoryDB(Item *item)
+{
+	DP_LOG_FUNC();
+
+	if (!item) {
+		DP_LOGE("Item is NULL");
+		return false;
+	}
+
+	if (item->historyId() == INVALID_HISTORY_ID) {
+		DP_LOGE("Cannot add to DB. Because historyId is invaild");
 		return false;
+	}
+
+	HistoryOp *op = new HistoryOp();
+	op->type = HISTORY_OP::INSERT;
+	op->historyId = item->historyId();
+	op->downloadType = item->downloadType();
+	op->contentType = item->contentType();
+	op->state = item->state();
+	op->err = item->errorCode();
+	op->name = item->title();
+	op->path = item->registeredFilePath();
+	op->url = item->url();
+	op->cookie = item->cookie();
+	op->date = item->finishedTime();
+	return pushOp(op);
 }
 
-bool DownloadHistoryDB::createItemsFromHistoryDB()
+bool DownloadHistoryDB::applyInsert(HistoryOp *op)
 {
 	int ret = 0;
 	sqlite3_stmt *stmt = NULL;
-	string tmp;
-	stringstream limitStr;
 
-	DP_LOG_FUNC();
+	stmt = writerDb.getStatement("insert into history (historyid, \
+		downloadtype, contenttype, state, err, name, path, url, cookie, \
+		date) values(?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+	if (!stmt)
+		return false;
 
-	if (!open()) {
-		DP_LOGE("historyDB is NULL");
+	/* binding values */
+	if (sqlite3_bind_int64(stmt, 1, op->historyId) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int64 is failed.");
+	if (sqlite3_bind_int(stmt, 2, op->downloadType) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int is failed.");
+	if (sqlite3_bind_int(stmt, 3, op->contentType) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int is failed.");
+	if (sqlite3_bind_int(stmt, 4, op->state) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int is failed.");
+	if (sqlite3_bind_int(stmt, 5, op->err) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int is failed.");
+	if (sqlite3_bind_text(stmt, 6, op->name.c_str(), -1, NULL) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_text is failed.");
+	if (sqlite3_bind_text(stmt, 7, op->path.c_str(), -1, NULL) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_text is failed.");
+	if (sqlite3_bind_text(stmt, 8, op->url.c_str(), -1, NULL) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_text is failed.");
+	if (sqlite3_bind_text(stmt, 9, op->cookie.c_str(), -1, NULL) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_text is failed.");
+	if (sqlite3_bind_double(stmt, 10, op->date) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_double is failed.");
+	ret = sqlite3_step(stmt);
+
+	DP_LOGD("SQL return: %s", (ret == SQLITE_DONE)?"Success":"Fail");
+
+	writerDb.releaseStatement(stmt);
+	if (ret != SQLITE_DONE)
 		return false;
+
+	stmt = writerDb.getStatement("update history_meta set value=? \
+		where key='next_history_id' and value<?");
+	if (!stmt)
+		return false;
+	if (sqlite3_bind_int64(stmt, 1, op->historyId + 1) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int64 is failed.");
+	if (sqlite3_bind_int64(stmt, 2, op->historyId + 1) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int64 is failed.");
+	ret = sqlite3_step(stmt);
+	writerDb.releaseStatement(stmt);
+
+	return ret == SQLITE_DONE;
+}
+
+/* The text is copied once from the buffer of sqlite.
+ * Its length is given by sqlite, so it is not counted again */
+unsigned int DownloadHistoryDB::getColumnText(sqlite3_stmt *stmt, int col,
+	string &outBuf)
+{
+	const char *text = (const char *)(sqlite3_column_text(stmt, col));
+	if (!text) {
+		outBuf.clear();
+		return 0;
 	}
-	limitStr << LOAD_HISTORY_COUNT;
-	tmp.append("select historyid, downloadtype, contenttype, state, err, ");
-	tmp.append("name, path, url, cookie, date from history order by ");
-	tmp.append("date DESC limit ");
-	tmp.append(limitStr.str());
-	ret = sqlite3_prepare_v2(historyDb, tmp.c_str(), -1, &stmt, NULL);
-	if (ret != SQLITE_OK)
-		FINALIZE_ON_ERROR(stmt);
+	int len = sqlite3_column_bytes(stmt, col);
+	outBuf.assign(text, len);
+	return len;
+}
 
+Item *DownloadHistoryDB::createItemFromRow(HistoryRow &row)
+{
+	Item *item = Item::createHistoryItem();
+	if (!item) {
+		DP_LOGE("Fail to create item");
+		return NULL;
+	}
+	item->setHistoryId(row.historyId);
+	item->setDownloadType((DL_TYPE::TYPE)row.downloadType);
+	item->setContentType(row.contentType);
+	item->setState((ITEM::STATE)row.state);
+	item->setErrorCode((ERROR::CODE)row.err);
+	if (!row.name.empty())
+		item->swapTitle(row.name);
+	item->swapRegisteredFilePath(row.path);
+	item->setFinishedTime(row.date);
+	return item;
+}
+
+/* Read the next page of history after the cursor position.
+ * This uses the date index instead of offset,
+ * so the cost of a page does not depend on how many rows are already loaded.
+ * This does not touch items, so it can be called at the reader thread */
+bool DownloadHistoryDB::readHistoryRows(HistoryDBConnection &conn,
+	HistoryCursor &cursor, int limit, vector<HistoryRow> &rows)
+{
+	int ret = 0;
+	int rowCount = 0;
+	unsigned long decodedBytes = 0;
+	sqlite3_stmt *stmt = NULL;
+
+	if (cursor.isEnd())
+		return true;
+
+	/* Only the columns for the list are read */
+	if (!cursor.isStarted()) {
+		stmt = conn.getStatement("select id, historyid, downloadtype, \
+			contenttype, state, err, name, path, date \
+			from history order by date DESC, id DESC limit ?");
+		if (!stmt)
+			return false;
+		if (sqlite3_bind_int(stmt, 1, limit) != SQLITE_OK)
+			DP_LOGE("sqlite3_bind_int is failed.");
+	} else {
+		stmt = conn.getStatement("select id, historyid, downloadtype, \
+			contenttype, state, err, name, path, date \
+			from history where date <= ? and (date < ? or id < ?) \
+			order by date DESC, id DESC limit ?");
+		if (!stmt)
+			return false;
+		if (sqlite3_bind_double(stmt, 1, cursor.lastDate()) != SQLITE_OK)
+			DP_LOGE("sqlite3_bind_double is failed.");
+		if (sqlite3_bind_double(stmt, 2, cursor.lastDate()) != SQLITE_OK)
+			DP_LOGE("sqlite3_bind_double is failed.");
+		if (sqlite3_bind_int(stmt, 3, cursor.lastId()) != SQLITE_OK)
+			DP_LOGE("sqlite3_bind_int is failed.");
+		if (sqlite3_bind_int(stmt, 4, limit) != SQLITE_OK)
+			DP_LOGE("sqlite3_bind_int is failed.");
+	}
+
+	rows.reserve(rows.size() + limit);
 	for (;;) {
 		ret = sqlite3_step(stmt);
-		if (ret == SQLITE_ROW) {
-			const char *tempStr = NULL;
-			string arg = string();
-			string url = string();
-			string cookie = string();
-			Item *item = Item::createHistoryItem();
-			if (!item) {
-				DP_LOGE("Fail to create item");
-				break;
-			}
-			item->setHistoryId(sqlite3_column_int(stmt,0));
-			item->setDownloadType((DL_TYPE::TYPE)sqlite3_column_int(stmt,1));
-			item->setContentType(sqlite3_column_int(stmt,2));
-			item->setState((ITEM::STATE)sqlite3_column_int(stmt,3));
-			item->setErrorCode((ERROR::CODE)sqlite3_column_int(stmt,4));
-			tempStr = (const char *)(sqlite3_column_text(stmt,5));
-			if (tempStr) {
-				arg = tempStr;
-				item->setTitle(arg);
-			}
-			tempStr = (const char *)(sqlite3_column_text(stmt,6));
-			if (tempStr)
-				arg = tempStr;
-			item->setRegisteredFilePath(arg);
-			tempStr = (const char *)(sqlite3_column_text(stmt,7));
-			if (tempStr)
-				url = tempStr;
-			tempStr = (const char *)(sqlite3_column_text(stmt,8));
-			if (tempStr)
-				cookie = tempStr;
-			item->setFinishedTime(sqlite3_column_double(stmt,9));
-			item->attachHistoryItem();
-			item->setRetryData(url, cookie);
-		} else
+		if (ret != SQLITE_ROW)
 			break;
+		rows.push_back(HistoryRow());
+		HistoryRow &row = rows.back();
+		/* column 0 is id, which is only used for the cursor */
+		row.historyId = sqlite3_column_int64(stmt,1);
+		row.downloadType = sqlite3_column_int(stmt,2);
+		row.contentType = sqlite3_column_int(stmt,3);
+		row.state = sqlite3_column_int(stmt,4);
+		row.err = sqlite3_column_int(stmt,5);
+		decodedBytes += getColumnText(stmt, 6, row.name);
+		decodedBytes += getColumnText(stmt, 7, row.path);
+		row.date = sqlite3_column_double(stmt,8);
+		cursor.moveTo(row.date, sqlite3_column_int(stmt,0));
+		rowCount++;
 	}
-	DP_LOGD("SQL error: %d", ret);
+	DP_LOGD("SQL return: %d rows[%d] text bytes per row[%lu]", ret, rowCount,
+		rowCount > 0 ? decodedBytes / rowCount : 0);
 
-	if (sqlite3_finalize(stmt) != SQLITE_OK)
-		DP_LOGE("sqlite3_finalize is failed.");
-	close();
+	conn.releaseStatement(stmt);
+
+	if (ret == SQLITE_DONE && rowCount < limit)
+		cursor.setEnd();
 
 	if (ret == SQLITE_DONE || ret == SQLITE_ROW)
 		return true;
@@ -322,101 +935,342 @@ bool DownloadHistoryDB::createItemsFromHistoryDB()
 		return false;
 }
 
-bool DownloadHistoryDB::deleteItem(unsigned int historyId)
+/* The rows are added to the view at once */
+void DownloadHistoryDB::createItemsFromRows(vector<HistoryRow> &rows)
+{
+	Items &inst = Items::getInstance();
+	vector<Item *> items;
+	vector<HistoryRow>::iterator it;
+
+	double attachTime = ecore_time_get();
+	items.reserve(rows.size());
+	for (it = rows.begin(); it != rows.end(); it++) {
+		/* It can be finished and written after the reader started */
+		if (inst.isExistedHistoryId(it->historyId))
+			continue;
+		Item *item = createItemFromRow(*it);
+		if (!item)
+			break;
+		items.push_back(item);
+	}
+	Item::attachHistoryItems(items);
+	DP_LOGD("attached rows[%d] time[%.3f]", (int)items.size(),
+		ecore_time_get() - attachTime);
+}
+
+/* Read and add the next page at the caller.
+ * This is used when the reader thread cannot be started */
+bool DownloadHistoryDB::createItemsFromHistoryDB(HistoryCursor &cursor,
+	int limit)
+{
+	vector<HistoryRow> rows;
+
+	DP_LOG_FUNC();
+
+	bool ret = readHistoryRows(historyDb, cursor, limit, rows);
+	createItemsFromRows(rows);
+	return ret;
+}
+
+/* The reader thread reads history page by page, and the main loop adds
+ * one page to the view in each iteration. So the list is drawn and
+ * scrolled while the rest is read. The first page fills one screen */
+bool DownloadHistoryDB::startReader(HistoryReadCB cb, void *data)
 {
 	int ret = 0;
-	sqlite3_stmt *stmt = NULL;
 
 	DP_LOG_FUNC();
 
-	if (!open()) {
-		DP_LOGE("historyDB is NULL");
+	if (isReaderRunning)
+		return true;
+
+	readerEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (readerEventFd < 0) {
+		DP_LOGE("Fail to create eventfd");
+		return false;
+	}
+	readerFdHandler = ecore_main_fd_handler_add(readerEventFd, ECORE_FD_READ,
+		readerFdHandlerCB, NULL, NULL, NULL);
+	if (!readerFdHandler) {
+		DP_LOGE("Fail to add fd handler");
+		::close(readerEventFd);
+		readerEventFd = -1;
 		return false;
 	}
+	readerCB = cb;
+	readerCBData = data;
+	isReadDone = false;
+	isReadFailed = false;
+	isReaderRunning = true;
 
-	ret = sqlite3_prepare_v2(historyDb, "delete from history where historyid=?",
-		-1, &stmt, NULL);
+	ret = pthread_create(&readerThread, NULL, readerThreadMain, NULL);
+	if (ret != 0) {
+		DP_LOGE("Fail to create reader thread : %d", ret);
+		isReaderRunning = false;
+		ecore_main_fd_handler_del(readerFdHandler);
+		readerFdHandler = NULL;
+		::close(readerEventFd);
+		readerEventFd = -1;
+		return false;
+	}
+	return true;
+}
 
-	if (ret != SQLITE_OK)
-		FINALIZE_ON_ERROR(stmt);
-	if (sqlite3_bind_int(stmt, 1, historyId) != SQLITE_OK)
-		DP_LOGE("sqlite3_bind_int is failed.");
-	ret = sqlite3_step(stmt);
-	if (ret != SQLITE_OK && ret != SQLITE_DONE)
-		FINALIZE_ON_ERROR(stmt);
+void DownloadHistoryDB::stopReader()
+{
+	pthread_mutex_lock(&readerMutex);
+	if (!isReaderRunning) {
+		pthread_mutex_unlock(&readerMutex);
+		return;
+	}
+	isReaderRunning = false;
+	pthread_cond_signal(&readerCond);
+	pthread_mutex_unlock(&readerMutex);
 
-	if (sqlite3_finalize(stmt) != SQLITE_OK)
-		DP_LOGE("sqlite3_finalize is failed.");
-	close();
-	return true;
+	pthread_join(readerThread, NULL);
+
+	while (!readBatches.empty()) {
+		delete readBatches.front();
+		readBatches.pop_front();
+	}
+	if (readerFdHandler) {
+		ecore_main_fd_handler_del(readerFdHandler);
+		readerFdHandler = NULL;
+	}
+	if (readerEventFd >= 0) {
+		::close(readerEventFd);
+		readerEventFd = -1;
+	}
+	readerCB = NULL;
+	readerCBData = NULL;
+}
+
+void *DownloadHistoryDB::readerThreadMain(void *data)
+{
+	HistoryCursor cursor;
+	int limit = LOAD_HISTORY_FIRST_COUNT;
+	int retryCount = 0;
+	bool isDone = false;
+	bool isFailed = false;
+
+	DP_LOG_FUNC();
+
+	while (!isDone) {
+		pthread_mutex_lock(&readerMutex);
+		/* Don't read ahead of the view too much */
+		while (isReaderRunning && readBatches.size() >= HISTORY_READ_BATCHES)
+			pthread_cond_wait(&readerCond, &readerMutex);
+		if (!isReaderRunning) {
+			pthread_mutex_unlock(&readerMutex);
+			break;
+		}
+		pthread_mutex_unlock(&readerMutex);
+
+		vector<HistoryRow> *rows = new vector<HistoryRow>();
+		/* The cursor is moved only by the rows which are read.
+		 * So a failed page is read again from where it stopped */
+		if (readHistoryRows(readerDb, cursor, limit, *rows)) {
+			retryCount = 0;
+			limit = LOAD_HISTORY_COUNT;
+			isDone = cursor.isEnd();
+		} else if (retryCount < HISTORY_READ_RETRY) {
+			retryCount++;
+			DP_LOGE("Fail to read history. retry[%d]", retryCount);
+		} else {
+			DP_LOGE("Fail to read history after [%d] retries",
+				retryCount);
+			isFailed = true;
+			isDone = true;
+		}
+
+		pthread_mutex_lock(&readerMutex);
+		if (rows->empty())
+			delete rows;
+		else
+			readBatches.push_back(rows);
+		if (isDone) {
+			isReadDone = true;
+			isReadFailed = isFailed;
+		}
+		pthread_mutex_unlock(&readerMutex);
+
+		if (retryCount > 0 && !isDone)
+			usleep(HISTORY_READ_RETRY_DELAY);
+
+		if (eventfd_write(readerEventFd, 1) < 0)
+			DP_LOGE("Fail to write eventfd");
+	}
+
+	readerDb.close();
+	return NULL;
+}
+
+Eina_Bool DownloadHistoryDB::readerFdHandlerCB(void *data,
+	Ecore_Fd_Handler *fdHandler)
+{
+	eventfd_t value = 0;
+	vector<HistoryRow> *rows = NULL;
+	bool hasMore = false;
+	bool isEnd = false;
+	bool isFailed = false;
+	int rowCount = 0;
+
+	if (eventfd_read(readerEventFd, &value) < 0)
+		DP_LOGD("eventfd is already read");
+
+	pthread_mutex_lock(&readerMutex);
+	if (!readBatches.empty()) {
+		rows = readBatches.front();
+		readBatches.pop_front();
+		pthread_cond_signal(&readerCond);
+	}
+	hasMore = !readBatches.empty();
+	isEnd = isReadDone && readBatches.empty();
+	isFailed = isEnd && isReadFailed;
+	pthread_mutex_unlock(&readerMutex);
+
+	if (rows) {
+		rowCount = rows->size();
+		createItemsFromRows(*rows);
+		delete rows;
+	}
+	/* Add one batch in an iteration, so the list is drawn between them */
+	if (hasMore && eventfd_write(readerEventFd, 1) < 0)
+		DP_LOGE("Fail to write eventfd");
+
+	if (readerCB && (rowCount > 0 || isEnd))
+		readerCB(readerCBData, rowCount, isEnd, isFailed);
+
+	if (isEnd) {
+		readerFdHandler = NULL;
+		return ECORE_CALLBACK_CANCEL;
+	}
+	return ECORE_CALLBACK_RENEW;
 }
 
-bool DownloadHistoryDB::deleteMultipleItem(queue <unsigned int> &q)
+/* Url and cookie are not loaded with the list.
+ * They are read by the history id when the item is retried */
+bool DownloadHistoryDB::getRetryData(unsigned long long historyId,
+	string &url, string &cookie)
 {
 	int ret = 0;
-	unsigned int historyId = -1;
 	sqlite3_stmt *stmt = NULL;
-	char *errmsg = NULL;
 
+	stmt = historyDb.getStatement("select url, cookie from history \
+		where historyid=?");
+	if (!stmt)
+		return false;
+	if (sqlite3_bind_int64(stmt, 1, historyId) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int64 is failed.");
+	ret = sqlite3_step(stmt);
+	if (ret == SQLITE_ROW) {
+		getColumnText(stmt, 0, url);
+		getColumnText(stmt, 1, cookie);
+	}
+	DP_LOGD("SQL return: %d", ret);
+	historyDb.releaseStatement(stmt);
+	return ret == SQLITE_ROW;
+}
+
+bool DownloadHistoryDB::deleteItem(unsigned long long historyId)
+{
 	DP_LOG_FUNC();
 
-	if (!open()) {
-		DP_LOGE("historyDB is NULL");
+	HistoryOp *op = new HistoryOp();
+	op->type = HISTORY_OP::DELETE;
+	op->historyId = historyId;
+	return pushOp(op);
+}
+
+bool DownloadHistoryDB::applyDelete(HistoryOp *op)
+{
+	int ret = 0;
+	sqlite3_stmt *stmt = NULL;
+
+	stmt = writerDb.getStatement("delete from history where historyid=?");
+	if (!stmt)
 		return false;
-	}
-	ret = sqlite3_exec(historyDb, "PRAGMA synchronous=OFF;\
-		PRAGMA count_changes=OFF; PRAGMA temp_store=memory;",
-		NULL, NULL, &errmsg);
-	if (SQLITE_OK != ret) {
-		sqlite3_free(errmsg);
-		close();
+
+	if (sqlite3_bind_int64(stmt, 1, op->historyId) != SQLITE_OK)
+		DP_LOGE("sqlite3_bind_int64 is failed.");
+	ret = sqlite3_step(stmt);
+	writerDb.releaseStatement(stmt);
+
+	if (ret != SQLITE_OK && ret != SQLITE_DONE) {
+		DP_LOG("SQL error: %d", ret);
 		return false;
 	}
+	return true;
+}
 
-	DP_LOGD("queue size[%d]",q.size());
+bool DownloadHistoryDB::deleteMultipleItem(queue <unsigned long long> &q)
+{
+	DP_LOG_FUNC();
+
+	DP_LOGD("queue size[%d]", (int)q.size());
+	if (q.empty())
+		return true;
+
+	HistoryOp *op = new HistoryOp();
+	op->type = HISTORY_OP::DELETE_MULTIPLE;
 	while (!q.empty()) {
-		ret = sqlite3_prepare_v2(historyDb, "delete from history where historyid=?",
-			-1, &stmt, NULL);
-		if (ret != SQLITE_OK)
-			FINALIZE_ON_ERROR(stmt);
-		historyId = q.front();
+		op->ids.push(q.front());
 		q.pop();
-		if (sqlite3_bind_int(stmt, 1, historyId) != SQLITE_OK)
-			DP_LOGE("sqlite3_bind_int is failed.");
-		ret = sqlite3_step(stmt);
-		if (ret != SQLITE_OK && ret != SQLITE_DONE)
-			FINALIZE_ON_ERROR(stmt);
 	}
-
-	if (sqlite3_finalize(stmt) != SQLITE_OK)
-		DP_LOGE("sqlite3_finalize is failed.");
-	close();
-	return true;
+	return pushOp(op);
 }
 
-bool DownloadHistoryDB::clearData(void)
+/* Delete all of the selected items with one statement.
+ * The ids are collected to a temporary table.
+ * This runs in the transaction of the writer */
+bool DownloadHistoryDB::applyDeleteMultiple(HistoryOp *op)
 {
 	int ret = 0;
+	unsigned long long historyId = INVALID_HISTORY_ID;
 	sqlite3_stmt *stmt = NULL;
+	/* The op keeps its ids in case the batch is written again */
+	queue<unsigned long long> ids = op->ids;
 
-	DP_LOG_FUNC();
+	if (!writerDb.execSQL("create temp table if not exists delete_ids(\
+			historyid integer primary key);"))
+		return false;
 
-	if (!open()) {
-		DP_LOGE("historyDB is NULL");
+	stmt = writerDb.getStatement(
+		"insert or ignore into temp.delete_ids values(?)");
+	if (!stmt)
 		return false;
+	while (!ids.empty()) {
+		historyId = ids.front();
+		ids.pop();
+		if (sqlite3_bind_int64(stmt, 1, historyId) != SQLITE_OK)
+			DP_LOGE("sqlite3_bind_int64 is failed.");
+		ret = sqlite3_step(stmt);
+		writerDb.releaseStatement(stmt);
+		if (ret != SQLITE_DONE) {
+			DP_LOG("SQL error: %d", ret);
+			writerDb.execSQL("delete from temp.delete_ids;");
+			return false;
+		}
 	}
 
-	ret = sqlite3_prepare_v2(historyDb, "delete from history", -1, &stmt, NULL);
-	if (ret != SQLITE_OK)
-		FINALIZE_ON_ERROR(stmt);
+	if (!writerDb.execSQL("delete from history where historyid in \
+			(select historyid from temp.delete_ids);")) {
+		writerDb.execSQL("delete from temp.delete_ids;");
+		return false;
+	}
+	return writerDb.execSQL("delete from temp.delete_ids;");
+}
 
-	ret = sqlite3_step(stmt);
-	if (ret != SQLITE_DONE)
-		FINALIZE_ON_ERROR(stmt);
+bool DownloadHistoryDB::clearData(void)
+{
+	DP_LOG_FUNC();
 
-	if (sqlite3_finalize(stmt) != SQLITE_OK)
-		DP_LOGE("sqlite3_finalize is failed.");
-	close();
-	return true;
+	HistoryOp *op = new HistoryOp();
+	op->type = HISTORY_OP::CLEAR;
+	return pushOp(op);
 }
 
+bool DownloadHistoryDB::applyClear(HistoryOp *op)
+{
+	return writerDb.execSQL("delete from history;");
+}
@@ -28,30 +28,49 @@
 #include "download-manager-viewItem.h"
 #include "download-manager-history-db.h"
 #include "download-manager-network.h"
+#include "download-manager-slab.h"
+
+#include <new>
+
+static SlabAllocator itemSlab("Item", sizeof(Item), SLAB_OBJS_PER_PAGE);
+
+void *Item::operator new(size_t size)
+{
+	void *p = itemSlab.alloc(size);
+	if (!p)
+		throw bad_alloc();
+	return p;
+}
+
+void Item::operator delete(void *p)
+{
+	itemSlab.free(p);
+}
 
 Item::Item()
 	: m_state(ITEM::IDLE)
 	, m_errorCode(ERROR::NONE)
-	, m_historyId(-1)
+	, m_historyId(INVALID_HISTORY_ID)
 	, m_contentType(DP_CONTENT_UNKOWN)
+	, m_iconType(DP_CONTENT_UNKOWN)
 	, m_finishedTime(0)
 	, m_downloadType(DL_TYPE::TYPE_NONE)
 	, m_gotFirstData(false)
 {
-// FIXME Later : init private members
+	m_title = S_("IDS_COM_BODY_NO_NAME");
 }
 
 Item::Item(DownloadRequest &rRequest)
 	: m_state(ITEM::IDLE)
 	, m_errorCode(ERROR::NONE)
-	, m_historyId(-1)
+	, m_historyId(INVALID_HISTORY_ID)
 	, m_contentType(DP_CONTENT_UNKOWN)
+	, m_iconType(DP_CONTENT_UNKOWN)
 	, m_finishedTime(0)
 	, m_downloadType(DL_TYPE::TYPE_NONE)
 	, m_gotFirstData(false)
 {
 	m_title = S_("IDS_COM_BODY_NO_NAME");
-	m_iconPath = DP_UNKNOWN_ICON_PATH;
 	m_aptr_request = auto_ptr<DownloadRequest>(new DownloadRequest(rRequest));	// FIXME ???
 }
 
@@ -75,12 +94,11 @@ void Item::create(DownloadRequest &rRequest)
 	newItem->download();
 }
 
+/* History item keeps only the data for the list.
+ * Download request and engine data are created when it is retried */
 Item *Item::createHistoryItem()
 {
-	string url = string();
-	string cookie = string();
-	DownloadRequest request(url,cookie);
-	Item *newItem = new Item(request);
+	Item *newItem = new Item();
 //	DP_LOGD_FUNC();
 
 	DP_LOGD("new History Item[%p]",newItem);
@@ -88,14 +106,17 @@ Item *Item::createHistoryItem()
 	return newItem;
 }
 
-void Item::attachHistoryItem()
+void Item::attachHistoryItems(vector<Item *> &historyItems)
 {
 	Items &items = Items::getInstance();
 
-	DP_LOGD("attach History Item[%p]",this);
-	items.attachItem(this);
-	ViewItem::create(this);
-	extractIconPath();
+	DP_LOGD("attach History Items[%d]", (int)historyItems.size());
+	vector<Item *>::iterator it;
+	for (it = historyItems.begin(); it != historyItems.end(); it++) {
+		items.attachItem(*it);
+		(*it)->extractIconPath();
+	}
+	ViewItem::createHistory(historyItems);
 }
 
 void Item::destroy()
@@ -109,13 +130,13 @@ void Item::destroy()
 	DP_LOGD("Item::destroy() notify()");
 
 	setState(ITEM::DESTROY);
-	notify();
+	notify(CHANGE::STATE);
 //	DP_LOG("Item::destroy() notify()... END");
-	m_aptr_downloadItem->deSubscribe(m_aptr_downloadObserver.get());
+	/* History item which is not retried doesn't have download data */
+	if (m_aptr_downloadItem.get())
+		m_aptr_downloadItem->deSubscribe(m_aptr_downloadObserver.get());
 	if (m_aptr_downloadObserver.get())
 		m_aptr_downloadObserver->clear();
-	else
-		DP_LOGE("download observer pointer is NULL");
 	/* When deleting item after download is failed */
 	if (m_aptr_netEventObserver.get()) {
 		NetMgr &netMgrInstance = NetMgr::getInstance();
@@ -144,11 +165,14 @@ void Item::download()
 	m_aptr_downloadItem->start(false);
 
 	DP_LOG("Item::download() notify()");
-	notify();
+	notify(CHANGE::STATE);
 }
 
 void Item::createSubscribeData() // autoptr's variable of this class.
 {
+	if (!m_aptr_request.get())
+		m_aptr_request = auto_ptr<DownloadRequest>(
+			new DownloadRequest(m_url, m_cookie));
 	m_aptr_downloadObserver = auto_ptr<Observer>(
 		new Observer(updateCBForDownloadObserver, this, "downloadItemObserver"));
 	m_aptr_netEventObserver = auto_ptr<Observer>(
@@ -161,21 +185,24 @@ void Item::createSubscribeData() // autoptr's variable of this class.
 	m_aptr_downloadItem->subscribe(m_aptr_downloadObserver.get());
 }
 
-void Item::startUpdate(void)
+/* Return the changed fields except state */
+unsigned int Item::startUpdate(void)
 {
 	if (m_gotFirstData) {
 		setState(ITEM::DOWNLOADING);
-		if (!registeredFilePath().empty())
+		if (!registeredFilePath().empty()) {
 			/* need to parse title again, because installed path can be changed */
 			extractTitle();
-		return;
+			return CHANGE::TITLE;
+		}
+		return CHANGE::NONE;
 	}
 
 	DP_LOGD_FUNC();
 
 	if (!m_aptr_downloadItem.get()) {
 		DP_LOGE("Fail to get download item");
-		return;
+		return CHANGE::NONE;
 	}
 	m_gotFirstData = true;
 //	setState(ITEM::DOWNLOADING);
@@ -186,18 +213,21 @@ void Item::startUpdate(void)
 	m_contentType = util.getContentType(
 		m_aptr_downloadItem->mimeType().c_str(), filePath().c_str());
 	extractIconPath();
+	return CHANGE::TITLE | CHANGE::ICON;
 }
 
-void Item::updateFromDownloadItem(void)
+void Item::updateFromDownloadItem(unsigned int dlChanged)
 {
 //	DP_LOGD_FUNC();
 	DownloadUtil &util = DownloadUtil::getInstance();
+	ITEM::STATE oldState = state();
+	unsigned int changed = dlChanged & CHANGE::PROGRESS;
 
 	switch (m_aptr_downloadItem->state()) {
 	case DL_ITEM::STARTED:
 		break;
 	case DL_ITEM::UPDATING:
-		startUpdate();
+		changed |= startUpdate();
 		break;
 	case DL_ITEM::COMPLETE_DOWNLOAD:
 		setState(ITEM::REGISTERING_TO_SYSTEM);
@@ -213,6 +243,7 @@ void Item::updateFromDownloadItem(void)
 		setState(ITEM::FINISH_DOWNLOAD);
 		/* need to parse title again, because installed path can be changed */
 		extractTitle();
+		changed |= CHANGE::TITLE;
 		handleFinishedItem();
 		util.registerContent(registeredFilePath());
 		break;
@@ -223,14 +254,20 @@ void Item::updateFromDownloadItem(void)
 	case DL_ITEM::FAILED:
 		setState(ITEM::FAIL_TO_DOWNLOAD);
 		setErrorCode(m_aptr_downloadItem->errorCode());
+		changed |= CHANGE::ERROR;
 		handleFinishedItem();
 		break;
 	default:
 		break;
 	}
 
-	DP_LOGD("Item[%p]::updateFromDownloadItem() notify() dl_state[%d]state[%d]", this, m_aptr_downloadItem->state(), state());
-	notify();
+	if (state() != oldState)
+		changed |= CHANGE::STATE;
+	if (changed == CHANGE::NONE)
+		return;
+
+	DP_LOGD("Item[%p]::updateFromDownloadItem() notify() dl_state[%d]state[%d]changed[%x]", this, m_aptr_downloadItem->state(), state(), changed);
+	notify(changed);
 }
 void Item::handleFinishedItem()
 {
@@ -285,59 +322,47 @@ void Item::extractTitle(void)
 
 void Item::extractIconPath()
 {
-	// FIXME Later : change 2 dimension array??
-	switch(m_contentType) {
-	case DP_CONTENT_IMAGE :
-		m_iconPath = DP_IMAGE_ICON_PATH;
-		break;
-	case DP_CONTENT_VIDEO :
-		m_iconPath = DP_VIDEO_ICON_PATH;
-		break;
-	case DP_CONTENT_MUSIC:
-		m_iconPath = DP_MUSIC_ICON_PATH;
-		break;
-	case DP_CONTENT_PDF:
-		m_iconPath = DP_PDF_ICON_PATH;
-		break;
-	case DP_CONTENT_WORD:
-		m_iconPath = DP_WORD_ICON_PATH;
-		break;
-	case DP_CONTENT_PPT:
-		m_iconPath = DP_PPT_ICON_PATH;
-		break;
-	case DP_CONTENT_EXCEL:
-		m_iconPath = DP_EXCEL_ICON_PATH;
-		break;
-	case DP_CONTENT_HTML:
-		m_iconPath = DP_HTML_ICON_PATH;
-		break;
-	case DP_CONTENT_TEXT:
-		m_iconPath = DP_TEXT_ICON_PATH;
-		break;
-	case DP_CONTENT_RINGTONE:
-		m_iconPath = DP_RINGTONE_ICON_PATH;
-		break;
-	case DP_CONTENT_DRM:
-		m_iconPath = DP_DRM_ICON_PATH;
-		break;
-	case DP_CONTENT_JAVA:
-		m_iconPath = DP_JAVA_ICON_PATH;
-		break;
-	case DP_CONTENT_UNKOWN:
-	default:
-		m_iconPath = DP_UNKNOWN_ICON_PATH;
-		break;
-	}
-}
-
-void Item::updateCBForDownloadObserver(void *data)
+	if (m_contentType < DP_CONTENT_NONE || m_contentType > DP_CONTENT_UNKOWN)
+		m_iconType = DP_CONTENT_UNKOWN;
+	else
+		m_iconType = m_contentType;
+}
+
+const char *Item::iconPathOfType(int type)
+{
+	/* Indexed by the content type */
+	static const char *iconPaths[DP_CONTENT_UNKOWN + 1] = {
+		DP_UNKNOWN_ICON_PATH,	/* DP_CONTENT_NONE */
+		DP_IMAGE_ICON_PATH,
+		DP_VIDEO_ICON_PATH,
+		DP_MUSIC_ICON_PATH,
+		DP_PDF_ICON_PATH,
+		DP_WORD_ICON_PATH,
+		DP_PPT_ICON_PATH,
+		DP_EXCEL_ICON_PATH,
+		DP_HTML_ICON_PATH,
+		DP_TEXT_ICON_PATH,
+		DP_RINGTONE_ICON_PATH,
+		DP_DRM_ICON_PATH,
+		DP_JAVA_ICON_PATH,
+		DP_UNKNOWN_ICON_PATH,	/* DP_CONTENT_SVG */
+		DP_UNKNOWN_ICON_PATH,	/* DP_CONTENT_FLASH */
+		DP_UNKNOWN_ICON_PATH	/* DP_CONTENT_UNKOWN */
+	};
+
+	if (type < DP_CONTENT_NONE || type > DP_CONTENT_UNKOWN)
+		type = DP_CONTENT_UNKOWN;
+	return iconPaths[type];
+}
+
+void Item::updateCBForDownloadObserver(void *data, unsigned int changed)
 {
 	DP_LOGD_FUNC();
 	if (data)
-		static_cast<Item*>(data)->updateFromDownloadItem();
+		static_cast<Item*>(data)->updateFromDownloadItem(changed);
 }
 
-void Item::netEventCBObserver(void *data)
+void Item::netEventCBObserver(void *data, unsigned int changed)
 {
 	/* It is only considerd that there is one network event which is suspend now.
 	 * If other network evnet is added,
@@ -436,56 +461,62 @@ string &Item::cookie()
 
 void Item::createHistoryId()
 {
-	int count = 0;
-	unsigned tempId = time(NULL);
-	while (isExistedHistoryId(tempId)) {
-		srand((unsigned)(time(NULL)));
-		tempId = rand();
-		count++;
-		if (count > 100) {
-			DP_LOGE("Fail to create unique ID");
-			tempId = -1;
-			break;
-		}
-		DP_LOGD("random historyId[%ld]", m_historyId);
-	}
-	m_historyId = tempId;
+	unsigned long long tempId = DownloadHistoryDB::createHistoryId();
+	/* Only if the next id of DB was not loaded */
+	while (isExistedHistoryId(tempId))
+		tempId = DownloadHistoryDB::createHistoryId();
+	DP_LOGD("historyId[%llu]", tempId);
+	setHistoryId(tempId);
+}
+
+void Item::setHistoryId(unsigned long long i)
+{
+	Items::getInstance().changeHistoryId(this, m_historyId, i);
+	m_historyId = i;
 }
 
-bool Item::isExistedHistoryId(unsigned int id)
+bool Item::isExistedHistoryId(unsigned long long id)
 {
 	Items &items = Items::getInstance();
 	return items.isExistedHistoryId(id);
 }
 
-void Item::setRetryData(string &url, string &cookie)
+/* A history item does not load url and cookie with the list */
+bool Item::loadRetryData()
 {
-
-	m_url = url;
-	m_cookie = cookie;
-	m_aptr_request->setUrl(url);
-	m_aptr_request->setCookie(cookie);
-
-	createSubscribeData();
-
+	if (m_aptr_downloadItem.get() || !m_url.empty())
+		return true;
+	if (m_historyId == INVALID_HISTORY_ID)
+		return false;
+	if (!DownloadHistoryDB::getRetryData(m_historyId, m_url, m_cookie)) {
+		DP_LOGE("Fail to get retry data of [%llu]", m_historyId);
+		return false;
+	}
+	return true;
 }
 
 bool Item::retry()
 {
 	DP_LOG_FUNC();
-	if (m_aptr_downloadItem.get()) {
-		NetMgr &netMgrInstance = NetMgr::getInstance();
-		setState(ITEM::PREPARE_TO_RETRY);
-		notify();
-		DownloadHistoryDB::deleteItem(m_historyId);
-		netMgrInstance.subscribe(m_aptr_netEventObserver.get());
-		m_historyId = -1;
-		m_aptr_downloadItem->retry();
-		return true;
-	} else {
-		m_state = ITEM::FAIL_TO_DOWNLOAD;
-		return false;
+	if (!m_aptr_downloadItem.get()) {
+		/* Keep the item and its history entry as they are */
+		if (!loadRetryData())
+			return false;
+		createSubscribeData();
+		if (!m_aptr_downloadItem.get()) {
+			setState(ITEM::FAIL_TO_DOWNLOAD);
+			notify(CHANGE::STATE);
+			return false;
+		}
 	}
+	NetMgr &netMgrInstance = NetMgr::getInstance();
+	setState(ITEM::PREPARE_TO_RETRY);
+	notify(CHANGE::STATE | CHANGE::PROGRESS | CHANGE::ERROR);
+	DownloadHistoryDB::deleteItem(m_historyId);
+	netMgrInstance.subscribe(m_aptr_netEventObserver.get());
+	setHistoryId(INVALID_HISTORY_ID);
+	m_aptr_downloadItem->retry();
+	return true;
 }
 
 void Item::clearForRetry()
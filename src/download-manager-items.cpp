@@ -23,30 +23,52 @@
 
 void Items::attachItem(Item *item)
 {
-	m_items.push_back(item);
+	m_items.insert(item);
+	if (item->historyId() != INVALID_HISTORY_ID)
+		m_historyItems[item->historyId()] = item;
 }
 
 void Items::detachItem(Item *item)
 {
-	vector<Item *>::iterator it;
-	for (it = m_items.begin(); it < m_items.end(); it++) {
-		if (*it == item) {
-			delete item;
-			m_items.erase(it);
-		}
-	}
+	if (m_items.find(item) == m_items.end())
+		return;
+	/* Remove the history id entry first.
+	 * changeHistoryId() ignores an item which is not in m_items */
+	changeHistoryId(item, item->historyId(), INVALID_HISTORY_ID);
+	m_items.erase(item);
+	delete item;
 }
 
-bool Items::isExistedHistoryId(unsigned int id)
+bool Items::isExistedHistoryId(unsigned long long id)
 {
-	vector <Item *>::iterator it;
-	for (it = m_items.begin(); it < m_items.end(); it++) {
-		if ((*it)->historyId() == id ) {
-			DP_LOGD("historyId[%ld],title[%s]",
-				(*it)->historyId(), (*it)->title().c_str());
-			return true;
-		}
+	Item *item = findItemByHistoryId(id);
+	if (item) {
+		DP_LOGD("historyId[%llu],title[%s]", id, item->title().c_str());
+		return true;
 	}
 	return false;
 }
 
+Item *Items::findItemByHistoryId(unsigned long long id)
+{
+	tr1::unordered_map<unsigned long long, Item *>::iterator it =
+		m_historyItems.find(id);
+	if (it == m_historyItems.end())
+		return NULL;
+	return it->second;
+}
+
+void Items::changeHistoryId(Item *item, unsigned long long oldId,
+	unsigned long long newId)
+{
+	if (m_items.find(item) == m_items.end())
+		return;
+	if (oldId != INVALID_HISTORY_ID) {
+		tr1::unordered_map<unsigned long long, Item *>::iterator it =
+			m_historyItems.find(oldId);
+		if (it != m_historyItems.end() && it->second == item)
+			m_historyItems.erase(it);
+	}
+	if (newId != INVALID_HISTORY_ID)
+		m_historyItems[newId] = item;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2012  Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.tizenopensource.org/license
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file	download-manager-slab.cpp
+ * @brief	Slab allocator for small objects which are created per item
+ */
+#include <stdlib.h>
+#include "download-manager-slab.h"
+#include "download-manager-common.h"
+
+/* Keep the objects aligned as malloc does */
+#define SLAB_ALIGN 16
+#define SLAB_ROUND_UP(s) (((s) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+/* Each object is placed after the header of its slot */
+#define SLAB_SLOT_HEADER SLAB_ROUND_UP(sizeof(Slot))
+#define SLAB_PAGE_HEADER SLAB_ROUND_UP(sizeof(Page))
+
+SlabAllocator::SlabAllocator(const char *name, size_t objSize,
+	int objsPerPage)
+	: m_name(name)
+	, m_objSize(objSize)
+	, m_slotSize(SLAB_SLOT_HEADER + SLAB_ROUND_UP(objSize))
+	, m_objsPerPage(objsPerPage)
+	, m_freePages(NULL)
+	, m_pageCount(0)
+	, m_objectCount(0)
+{
+}
+
+SlabAllocator::~SlabAllocator()
+{
+	DP_LOGD("[%s] pages[%lu] objects[%lu]", m_name, m_pageCount,
+		m_objectCount);
+	/* Pages which have live objects are left */
+	Page *page = m_freePages;
+	while (page) {
+		Page *next = page->next;
+		if (page->usedCount == 0) {
+			unlinkPage(page);
+			destroyPage(page);
+		}
+		page = next;
+	}
+}
+
+void *SlabAllocator::alloc(size_t size)
+{
+	if (size > m_objSize) {
+		DP_LOGD("[%s] size[%lu] is larger than the slot", m_name,
+			(unsigned long)size);
+		Slot *large = (Slot *)malloc(SLAB_SLOT_HEADER + size);
+		if (!large)
+			return NULL;
+		large->page = NULL;
+		large->nextFree = NULL;
+		return (char *)large + SLAB_SLOT_HEADER;
+	}
+	Page *page = m_freePages;
+	if (!page) {
+		page = createPage();
+		if (!page)
+			return NULL;
+	}
+	Slot *slot = page->freeSlots;
+	page->freeSlots = slot->nextFree;
+	page->usedCount++;
+	if (!page->freeSlots)
+		unlinkPage(page);
+	m_objectCount++;
+	return (char *)slot + SLAB_SLOT_HEADER;
+}
+
+void SlabAllocator::free(void *p)
+{
+	if (!p)
+		return;
+	Slot *slot = (Slot *)((char *)p - SLAB_SLOT_HEADER);
+	Page *page = slot->page;
+	if (!page) {
+		::free(slot);
+		return;
+	}
+	bool wasFull = (page->freeSlots == NULL);
+	slot->nextFree = page->freeSlots;
+	page->freeSlots = slot;
+	page->usedCount--;
+	m_objectCount--;
+	if (wasFull)
+		linkPage(page);
+	/* Keep one page to avoid freeing and creating it repeatedly */
+	if (page->usedCount == 0 && (page->prev || page->next)) {
+		unlinkPage(page);
+		destroyPage(page);
+	}
+}
+
+SlabAllocator::Page *SlabAllocator::createPage()
+{
+	char *mem = (char *)malloc(SLAB_PAGE_HEADER +
+		m_slotSize * m_objsPerPage);
+	if (!mem) {
+		DP_LOGE("[%s] Fail to allocate a page", m_name);
+		return NULL;
+	}
+	Page *page = (Page *)mem;
+	page->prev = NULL;
+	page->next = NULL;
+	page->freeSlots = NULL;
+	page->usedCount = 0;
+	/* Link the slots in address order */
+	for (int i = m_objsPerPage - 1; i >= 0; i--) {
+		Slot *slot = (Slot *)(mem + SLAB_PAGE_HEADER + m_slotSize * i);
+		slot->page = page;
+		slot->nextFree = page->freeSlots;
+		page->freeSlots = slot;
+	}
+	linkPage(page);
+	m_pageCount++;
+	return page;
+}
+
+void SlabAllocator::destroyPage(Page *page)
+{
+	::free(page);
+	m_pageCount--;
+}
+
+void SlabAllocator::linkPage(Page *page)
+{
+	page->prev = NULL;
+	page->next = m_freePages;
+	if (m_freePages)
+		m_freePages->prev = page;
+	m_freePages = page;
+}
+
+void SlabAllocator::unlinkPage(Page *page)
+{
+	if (page->prev)
+		page->prev->next = page->next;
+	else
+		m_freePages = page->next;
+	if (page->next)
+		page->next->prev = page->prev;
+	page->prev = NULL;
+	page->next = NULL;
+}
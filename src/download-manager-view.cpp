@@ -56,6 +56,13 @@ DownloadView::DownloadView(void)
 	, m_sweepedItem(NULL)
 #endif
 	, m_viewItemCount(0)
+	, m_checkGeneration(0)
+	, m_checkBase(EINA_FALSE)
+	, m_checkedCount(0)
+	, m_refreshAnimator(NULL)
+	, m_refreshTimer(NULL)
+	, m_refreshInterval(PROGRESS_REFRESH_INTERVAL)
+	, m_lastRefreshTime(0)
 {
 // FIXME Later : init private members
 	DownloadEngine &engine = DownloadEngine::getInstance();
@@ -67,6 +74,9 @@ DownloadView::DownloadView(void)
 	dldGenlistGroupStyle.func.content_get = NULL;
 	dldGenlistGroupStyle.func.state_get = NULL;
 	dldGenlistGroupStyle.func.del = NULL;
+	createGenlistItemClass();
+	for (int i = 0; i <= DP_CONTENT_UNKOWN; i++)
+		m_iconCache[i] = NULL;
 
 	m_today.setType(DATETIME::DATE_TYPE_TODAY);
 	m_yesterday.setType(DATETIME::DATE_TYPE_YESTERDAY);
@@ -100,6 +110,106 @@ void DownloadView::destroy()
 	DownloadEngine &engine = DownloadEngine::getInstance();
 	engine.deinitEngine();
 	ecore_timer_del(eoNotifyTimer);
+	if (m_refreshAnimator) {
+		ecore_animator_del(m_refreshAnimator);
+		m_refreshAnimator = NULL;
+	}
+	if (m_refreshTimer) {
+		ecore_timer_del(m_refreshTimer);
+		m_refreshTimer = NULL;
+	}
+	destroyGenlistItemClass();
+	clearIconCache();
+}
+
+void DownloadView::createGenlistItemClass()
+{
+	static const char *itemStyles[GENLIST_ITEM_CLASS::MAX] = {
+		"3text.3icon", "3text.1icon.2", "3text.1icon.2" };
+#ifndef _TIZEN_PUBLIC
+	static const char *decorateItemStyles[GENLIST_ITEM_CLASS::MAX] = {
+		"mode/slide", "mode/slide", "mode/slide2" };
+#endif
+
+	for (int i = 0; i < GENLIST_ITEM_CLASS::MAX; i++) {
+		Elm_Genlist_Item_Class *itc = elm_genlist_item_class_new();
+		if (!itc) {
+			DP_LOGE("Fail to create genlist item class");
+			m_genlistItemClass[i] = NULL;
+			continue;
+		}
+		itc->item_style = itemStyles[i];
+#ifndef _TIZEN_PUBLIC
+		itc->decorate_item_style = decorateItemStyles[i];
+#endif
+		itc->func.text_get = ViewItem::getGenlistLabelCB;
+		itc->func.content_get = ViewItem::getGenlistIconCB;
+		itc->func.state_get = NULL;
+		itc->func.del = NULL;
+		itc->decorate_all_item_style = "edit_default";
+		m_genlistItemClass[i] = itc;
+	}
+}
+
+/* The classes are freed when the genlist items which refer them are deleted */
+void DownloadView::destroyGenlistItemClass()
+{
+	for (int i = 0; i < GENLIST_ITEM_CLASS::MAX; i++) {
+		if (m_genlistItemClass[i]) {
+			elm_genlist_item_class_free(m_genlistItemClass[i]);
+			m_genlistItemClass[i] = NULL;
+		}
+	}
+}
+
+Evas_Object *DownloadView::cachedIcon(Evas *evas, int iconType)
+{
+	if (iconType < DP_CONTENT_NONE || iconType > DP_CONTENT_UNKOWN)
+		iconType = DP_CONTENT_UNKOWN;
+	if (!m_iconCache[iconType]) {
+		Evas_Object *image = evas_object_image_filled_add(evas);
+		if (!image) {
+			DP_LOGE("Fail to add icon image");
+			return NULL;
+		}
+		evas_object_image_file_set(image, Item::iconPathOfType(iconType),
+			NULL);
+		if (evas_object_image_load_error_get(image) != EVAS_LOAD_ERROR_NONE) {
+			DP_LOGE("Fail to load icon [%s]", Item::iconPathOfType(iconType));
+			evas_object_del(image);
+			return NULL;
+		}
+		evas_object_hide(image);
+		m_iconCache[iconType] = image;
+	}
+	return m_iconCache[iconType];
+}
+
+/* The row icon is a plain image of the cached file. Evas finds the decoded
+ * data of the cached image by the same path, so the loader is not called */
+Evas_Object *DownloadView::createIcon(Evas_Object *parent, int iconType)
+{
+	Evas *evas = evas_object_evas_get(parent);
+	Evas_Object *cached = cachedIcon(evas, iconType);
+	if (!cached)
+		return NULL;
+
+	Evas_Object *icon = evas_object_image_filled_add(evas);
+	if (!icon)
+		return NULL;
+	evas_object_image_file_set(icon, Item::iconPathOfType(iconType), NULL);
+	evas_object_size_hint_aspect_set(icon, EVAS_ASPECT_CONTROL_VERTICAL, 1, 1);
+	return icon;
+}
+
+void DownloadView::clearIconCache()
+{
+	for (int i = 0; i <= DP_CONTENT_UNKOWN; i++) {
+		if (m_iconCache[i]) {
+			evas_object_del(m_iconCache[i]);
+			m_iconCache[i] = NULL;
+		}
+	}
 }
 
 void DownloadView::show()
@@ -309,6 +419,7 @@ void DownloadView::changedRegion()
 {
 	DateUtil &inst = DateUtil::getInstance();
 	inst.updateLocale();
+	ViewItem::invalidateAllLabels();
 	elm_genlist_realized_items_update(eoDldList);
 }
 
@@ -322,13 +433,51 @@ void DownloadView::attachViewItem(ViewItem *viewItem)
 	if (viewItem) {
 		addViewItemToGenlist(viewItem);
 		m_viewItemCount++;
+		/* Not checked even if all items are checked at edit mode */
+		viewItem->setCheckedValue(EINA_FALSE);
+		updateActiveState(viewItem);
 	}
 }
 
+/* History view items which are ordered from the latest one.
+ * Date groups are found from one day boundary, and edje is frozen
+ * while the rows are appended */
+void DownloadView::attachViewItems(vector<ViewItem *> &viewItems)
+{
+	DP_LOG_FUNC();
+	if (viewItems.empty())
+		return;
+	if (m_viewItemCount < 1) {
+		hideEmptyView();
+		createList();
+	}
+
+	DateUtil &inst = DateUtil::getInstance();
+	DayBoundary boundary;
+	inst.getDayBoundary(boundary);
+
+	edje_freeze();
+	vector<ViewItem *>::iterator it;
+	for (it = viewItems.begin(); it != viewItems.end(); it++) {
+		ViewItem *viewItem = *it;
+		viewItem->extractDateGroupType(boundary);
+		createGenlistItem(viewItem);
+		m_viewItemCount++;
+		viewItem->setCheckedValue(EINA_FALSE);
+		updateActiveState(viewItem);
+	}
+	edje_thaw();
+	inst.setTodayStandardTime();
+}
+
 void DownloadView::detachViewItem(ViewItem *viewItem)
 {
 	DP_LOG("delete viewItem[%p]",viewItem);
 	if (viewItem) {
+		cancelRefresh(viewItem);
+		m_activeItems.erase(viewItem);
+		if (viewItem->checkedValue())
+			m_checkedCount--;
 		delete viewItem;
 		m_viewItemCount--;
 	}
@@ -337,6 +486,108 @@ void DownloadView::detachViewItem(ViewItem *viewItem)
 		showEmptyView();
 }
 
+/* Called when the view item is attached or its state is changed */
+void DownloadView::updateActiveState(ViewItem *viewItem)
+{
+	bool active = !viewItem->isFinished();
+	if (viewItem->isActive() == active)
+		return;
+	viewItem->setActive(active);
+	if (active) {
+		m_activeItems.insert(viewItem);
+	} else {
+		m_activeItems.erase(viewItem);
+		/* It is finished at edit mode after all items are checked */
+		viewItem->setCheckedValue(EINA_FALSE);
+	}
+}
+
+/* Progress of the view item is drawn at the next frame.
+ * All of the queued items are drawn together at most once per frame */
+void DownloadView::queueRefresh(ViewItem *viewItem)
+{
+	if (!viewItem || viewItem->isRefreshQueued())
+		return;
+	viewItem->setRefreshQueued(true);
+	m_refreshItems.push_back(viewItem);
+	if (!m_refreshAnimator && !m_refreshTimer)
+		m_refreshAnimator = ecore_animator_add(refreshAnimatorCB, this);
+}
+
+void DownloadView::cancelRefresh(ViewItem *viewItem)
+{
+	if (!viewItem->isRefreshQueued())
+		return;
+	vector<ViewItem *>::iterator it;
+	for (it = m_refreshItems.begin(); it != m_refreshItems.end(); it++) {
+		if (*it == viewItem) {
+			m_refreshItems.erase(it);
+			break;
+		}
+	}
+	viewItem->setRefreshQueued(false);
+}
+
+/* Used to draw progress less often, e.g. when the view is not visible */
+void DownloadView::setRefreshInterval(double interval)
+{
+	DP_LOGD("refresh interval[%.2f]", interval);
+	if (m_refreshInterval == interval)
+		return;
+	m_refreshInterval = interval;
+	/* The pending timer was set with the old interval.
+	 * Check the queued items again with the new one at the next frame */
+	if (m_refreshTimer) {
+		ecore_timer_del(m_refreshTimer);
+		m_refreshTimer = NULL;
+		if (!m_refreshAnimator)
+			m_refreshAnimator = ecore_animator_add(refreshAnimatorCB, this);
+	}
+}
+
+Eina_Bool DownloadView::refreshAnimatorCB(void *data)
+{
+	DownloadView *view = static_cast<DownloadView *>(data);
+	if (!view)
+		return ECORE_CALLBACK_CANCEL;
+
+	view->m_refreshAnimator = NULL;
+	double remained = view->m_lastRefreshTime + view->m_refreshInterval -
+		ecore_loop_time_get();
+	if (remained > 0) {
+		view->m_refreshTimer = ecore_timer_add(remained, refreshTimerCB,
+			view);
+		return ECORE_CALLBACK_CANCEL;
+	}
+	view->m_lastRefreshTime = ecore_loop_time_get();
+	view->refreshQueuedItems();
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/* Draw at the next frame after the interval is passed */
+Eina_Bool DownloadView::refreshTimerCB(void *data)
+{
+	DownloadView *view = static_cast<DownloadView *>(data);
+	if (!view)
+		return ECORE_CALLBACK_CANCEL;
+
+	view->m_refreshTimer = NULL;
+	view->m_refreshAnimator = ecore_animator_add(refreshAnimatorCB, view);
+	return ECORE_CALLBACK_CANCEL;
+}
+
+void DownloadView::refreshQueuedItems()
+{
+	vector<ViewItem *> items;
+	/* An item can be queued again while drawing */
+	items.swap(m_refreshItems);
+	vector<ViewItem *>::iterator it;
+	for (it = items.begin(); it != items.end(); it++)
+		(*it)->setRefreshQueued(false);
+	for (it = items.begin(); it != items.end(); it++)
+		(*it)->refreshProgress();
+}
+
 void DownloadView::update()
 {
 	Elm_Object_Item *it = NULL;
@@ -374,24 +625,16 @@ void DownloadView::update(Elm_Object_Item *glItem)
 #ifndef _TIZEN_PUBLIC
 ViewItem *DownloadView::findViewItemForGenlistItem(Elm_Object_Item *glItem)
 {
-	Elm_Object_Item *it = NULL;
-	ViewItem *viewItem = NULL;
 	if (!eoDldList) {
 		DP_LOGE("download list is NULL");
 		return NULL;
 	}
-	it = elm_genlist_first_item_get(eoDldList);
-	while (it) {
-		/* don't search group item */
-		if (elm_genlist_item_select_mode_get(it) !=
-				ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY && it == glItem) {
-			viewItem = (ViewItem *)elm_object_item_data_get(it);
-			break;
-		}
-		it = elm_genlist_item_next_get(it);
-	}
+	/* The data of a group item is not a view item */
+	if (!glItem || elm_genlist_item_select_mode_get(glItem) ==
+			ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY)
+		return NULL;
 
-	return viewItem;
+	return (ViewItem *)elm_object_item_data_get(glItem);
 }
 #endif
 
@@ -564,54 +807,35 @@ void DownloadView::changeAllCheckedValue()
 
 void DownloadView::destroyCheckedItem()
 {
-	Eina_List *list = NULL;
-	Elm_Object_Item *it = NULL;
-	ViewItem *item = NULL;
 	int checkedCount = 0;
-	queue <unsigned int> deleteQueue;
+	queue <unsigned long long> deleteQueue;
+	vector<ViewItem *> items;
 
 	DP_LOGD_FUNC();
 
-	it = elm_genlist_first_item_get(eoDldList);
-
-	while (it) {
-		item = (ViewItem *)elm_object_item_data_get(it);
-		/* elm_genlist_item_select_mode_get is needed to check group item */
-		if (elm_genlist_item_select_mode_get(it) !=
-				ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY &&
-				item && item->checkedValue()) {
-			list = eina_list_append(list, it);
-		}
-		it = elm_genlist_item_next_get(it);
-	}
-
-	if (!list) {
+	if (m_checkedCount < 1) {
 		DP_LOGD("There is no delete item");
 		return;
 	}
 
-	checkedCount = eina_list_count(list);
-	if (checkedCount < 1)
-		return;
+	Elm_Object_Item *glItem = elm_genlist_first_item_get(eoDldList);
+	while (glItem) {
+		ViewItem *viewItem = (ViewItem *)elm_object_item_data_get(glItem);
+		/* elm_genlist_item_select_mode_get is needed to check group item */
+		if (elm_genlist_item_select_mode_get(glItem) !=
+				ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY &&
+				viewItem && viewItem->checkedValue())
+			items.push_back(viewItem);
+		glItem = elm_genlist_item_next_get(glItem);
+	}
+	checkedCount = items.size();
 	DP_LOGD("checkedCount[%d]", checkedCount);
 
-	for (int i = 0; i < checkedCount; i++)
-	{
-		it = (Elm_Object_Item *)eina_list_data_get(list);
-		if (it)
-			item = (ViewItem *)elm_object_item_data_get(it);
-		else
-			DP_LOGE("genlist item is null");
-		list = eina_list_next(list);
-		if (item) {
-			deleteQueue.push(item->historyId());
-			item->destroy();
-		} else {
-			DP_LOGE("viewItem is null");
-		}
+	vector<ViewItem *>::iterator it;
+	for (it = items.begin(); it != items.end(); it++) {
+		deleteQueue.push((*it)->historyId());
+		(*it)->destroy();
 	}
-	if (list)
-		eina_list_free(list);
 
 	DownloadHistoryDB::deleteMultipleItem(deleteQueue);
 	showNotifyInfo(DOWNLOAD_NOTIFY_DELETED, checkedCount);
@@ -647,16 +871,10 @@ void DownloadView::showGenlistEditMode()
 	   it is same to click a check box. */
 	elm_genlist_select_mode_set(eoDldList, ELM_OBJECT_SELECT_MODE_ALWAYS);
 
-	Elm_Object_Item *it = NULL;
-	ViewItem *viewItem = NULL;
-	it = elm_genlist_first_item_get(eoDldList);
-	while (it) {
-		viewItem = (ViewItem *)elm_object_item_data_get(it);
-		if (elm_genlist_item_select_mode_get(it) !=
-				ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY &&
-				viewItem && !(viewItem->isFinished()))
-			elm_object_item_disabled_set(it, EINA_TRUE);
-		it = elm_genlist_item_next_get(it);
+	tr1::unordered_set<ViewItem *>::iterator it;
+	for (it = m_activeItems.begin(); it != m_activeItems.end(); it++) {
+		if ((*it)->genlistItem())
+			elm_object_item_disabled_set((*it)->genlistItem(), EINA_TRUE);
 	}
 	elm_object_item_disabled_set(eoCbItemDelete, EINA_TRUE);
 }
@@ -688,20 +906,18 @@ void DownloadView::hideGenlistEditMode()
 	elm_genlist_decorate_mode_set(eoDldList, EINA_FALSE);
 	elm_genlist_select_mode_set(eoDldList, ELM_OBJECT_SELECT_MODE_DEFAULT);
 
-	Elm_Object_Item *it = NULL;
-	ViewItem *viewItem = NULL;
-	it = elm_genlist_first_item_get(eoDldList);
-	while (it) {
-		viewItem = (ViewItem *)elm_object_item_data_get(it);
-		if (elm_genlist_item_select_mode_get(it) !=
-				ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY && viewItem) {
-			if (elm_object_item_disabled_get(it))
-				elm_object_item_disabled_set(it, EINA_FALSE);
-			viewItem->setCheckedValue(EINA_FALSE);
-			viewItem->setCheckedBtn(NULL);
-		}
-		it = elm_genlist_item_next_get(it);
+	/* Only the active items were disabled. The check buttons are
+	 * removed from the view items when they are deleted */
+	tr1::unordered_set<ViewItem *>::iterator it;
+	for (it = m_activeItems.begin(); it != m_activeItems.end(); it++) {
+		Elm_Object_Item *glItem = (*it)->genlistItem();
+		if (glItem && elm_object_item_disabled_get(glItem))
+			elm_object_item_disabled_set(glItem, EINA_FALSE);
 	}
+	/* Uncheck all items by starting a new check generation */
+	m_checkGeneration++;
+	m_checkBase = EINA_FALSE;
+	m_checkedCount = 0;
 
 	m_allChecked = EINA_FALSE;
 
@@ -715,21 +931,28 @@ void DownloadView::hideGenlistEditMode()
 void DownloadView::handleChangedAllCheckedState()
 {
 	int checkedCount = 0;
-	Elm_Object_Item *it = NULL;
-	ViewItem *viewItem = NULL;
-	it = elm_genlist_first_item_get(eoDldList);
-	while (it) {
-		viewItem = (ViewItem *)elm_object_item_data_get(it);
-		if (elm_genlist_item_select_mode_get(it) !=
-			ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY && viewItem) {
-			if (viewItem->isFinished()) {
-				viewItem->setCheckedValue(m_allChecked);
-				viewItem->updateCheckedBtn();
-				checkedCount++;
-			}
-		}
-		it = elm_genlist_item_next_get(it);
+	/* Other items get the new value when they are realized */
+	m_checkGeneration++;
+	m_checkBase = m_allChecked;
+	/* Active items cannot be checked */
+	tr1::unordered_set<ViewItem *>::iterator it;
+	for (it = m_activeItems.begin(); it != m_activeItems.end(); it++)
+		(*it)->setCheckedValue(EINA_FALSE);
+	if (m_allChecked)
+		checkedCount = m_viewItemCount - m_activeItems.size();
+	m_checkedCount = checkedCount;
+
+	Eina_List *realized = elm_genlist_realized_items_get(eoDldList);
+	Eina_List *l = NULL;
+	void *data = NULL;
+	EINA_LIST_FOREACH(realized, l, data) {
+		Elm_Object_Item *glItem = (Elm_Object_Item *)data;
+		ViewItem *viewItem = (ViewItem *)elm_object_item_data_get(glItem);
+		if (elm_genlist_item_select_mode_get(glItem) !=
+				ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY && viewItem)
+			viewItem->updateCheckedBtn();
 	}
+	eina_list_free(realized);
 
 	if (m_allChecked && checkedCount > 0) {
 		elm_object_item_disabled_set(eoCbItemDelete, EINA_FALSE);
@@ -740,27 +963,22 @@ void DownloadView::handleChangedAllCheckedState()
 	}
 }
 
-void DownloadView::handleCheckedState()
+/* Called after the checked value of the view item is changed */
+void DownloadView::handleCheckedState(ViewItem *viewItem)
 {
 	int checkedCount = 0;
 	int deleteAbleTotalCount = 0;
 
 	DP_LOGD_FUNC();
 
-	Elm_Object_Item *it = NULL;
-	ViewItem *viewItem = NULL;
-	it = elm_genlist_first_item_get(eoDldList);
-	while (it) {
-		viewItem = (ViewItem *)elm_object_item_data_get(it);
-		if (elm_genlist_item_select_mode_get(it) !=
-			ELM_OBJECT_SELECT_MODE_DISPLAY_ONLY && viewItem) {
-			if (viewItem->checkedValue())
-				checkedCount++;
-			if (viewItem->isFinished())
-				deleteAbleTotalCount++;
-		}
-		it = elm_genlist_item_next_get(it);
+	if (viewItem) {
+		if (viewItem->checkedValue())
+			m_checkedCount++;
+		else
+			m_checkedCount--;
 	}
+	checkedCount = m_checkedCount;
+	deleteAbleTotalCount = m_viewItemCount - m_activeItems.size();
 
 	if (checkedCount == deleteAbleTotalCount)
 		m_allChecked = EINA_TRUE;
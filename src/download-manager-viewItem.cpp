@@ -22,6 +22,47 @@
 #include "download-manager-viewItem.h"
 #include "download-manager-items.h"
 #include "download-manager-view.h"
+#include "download-manager-slab.h"
+
+#include <new>
+
+static SlabAllocator viewItemSlab("ViewItem", sizeof(ViewItem), SLAB_OBJS_PER_PAGE);
+
+void *ViewItem::operator new(size_t size)
+{
+	void *p = viewItemSlab.alloc(size);
+	if (!p)
+		throw bad_alloc();
+	return p;
+}
+
+void ViewItem::operator delete(void *p)
+{
+	viewItemSlab.free(p);
+}
+
+/* The count of genlist item updates which realize the whole item,
+ * and ones which update only some fields. It is logged once per second */
+static unsigned long full_update_count = 0;
+static unsigned long partial_update_count = 0;
+static double update_count_time = 0;
+
+static void __count_item_update(bool isFull)
+{
+	if (isFull)
+		full_update_count++;
+	else
+		partial_update_count++;
+
+	double now = ecore_time_get();
+	if (now - update_count_time < 1.0)
+		return;
+	DP_LOGD("genlist item update per second: full[%lu] partial[%lu]",
+		full_update_count, partial_update_count);
+	full_update_count = 0;
+	partial_update_count = 0;
+	update_count_time = now;
+}
 
 ViewItem::ViewItem(Item *item)
 	: m_item(item)
@@ -29,8 +70,14 @@ ViewItem::ViewItem(Item *item)
 	, m_progressBar(NULL)
 	, m_checkedBtn(NULL)
 	, m_checked(EINA_FALSE)
+	, m_checkGeneration(0)
 	, m_isRetryCase(false)
+	, m_isActive(false)
+	, m_pendingChanged(CHANGE::NONE)
+	, m_isRefreshQueued(false)
 	, m_dateGroupType(DATETIME::DATE_TYPE_NONE)
+	, m_validLabels(0)
+	, m_labelGeneration(labelGeneration)
 {
 	// FIXME need to makes exchange subject?? not yet, but keep it in mind!
 	if (item) {
@@ -38,37 +85,6 @@ ViewItem::ViewItem(Item *item)
 			new Observer(updateCB, this, "viewItemObserver"));
 		item->subscribe(m_aptr_observer.get());
 	}
-
-	dldGenlistStyle.item_style = "3text.3icon";
-#ifndef _TIZEN_PUBLIC
-	dldGenlistStyle.decorate_item_style = "mode/slide";
-#endif
-	dldGenlistStyle.func.text_get = getGenlistLabelCB;
-	dldGenlistStyle.func.content_get = getGenlistIconCB;
-	dldGenlistStyle.func.state_get = NULL;
-	dldGenlistStyle.func.del = NULL;
-	dldGenlistStyle.decorate_all_item_style = "edit_default";
-
-	dldHistoryGenlistStyle.item_style = "3text.1icon.2";
-#ifndef _TIZEN_PUBLIC
-	dldHistoryGenlistStyle.decorate_item_style = "mode/slide";
-#endif
-	dldHistoryGenlistStyle.func.text_get = getGenlistLabelCB;
-	dldHistoryGenlistStyle.func.content_get = getGenlistIconCB;
-	dldHistoryGenlistStyle.func.state_get = NULL;
-	dldHistoryGenlistStyle.func.del = NULL;
-	dldHistoryGenlistStyle.decorate_all_item_style = "edit_default";
-
-	dldGenlistSlideStyle.item_style = "3text.1icon.2";
-#ifndef _TIZEN_PUBLIC
-	dldGenlistSlideStyle.decorate_item_style = "mode/slide2";
-#endif
-	dldGenlistSlideStyle.func.text_get = getGenlistLabelCB;
-	dldGenlistSlideStyle.func.content_get= getGenlistIconCB;
-	dldGenlistSlideStyle.func.state_get = NULL;
-	dldGenlistSlideStyle.func.del = NULL;
-	dldGenlistSlideStyle.decorate_all_item_style = "edit_default";
-
 }
 
 ViewItem::~ViewItem()
@@ -84,6 +100,19 @@ void ViewItem::create(Item *item)
 	view.attachViewItem(newViewItem);
 }
 
+/* The view items are added to the genlist together */
+void ViewItem::createHistory(vector<Item *> &items)
+{
+	vector<ViewItem *> viewItems;
+	viewItems.reserve(items.size());
+	vector<Item *>::iterator it;
+	for (it = items.begin(); it != items.end(); it++)
+		viewItems.push_back(new ViewItem(*it));
+
+	DownloadView &view = DownloadView::getInstance();
+	view.attachViewItems(viewItems);
+}
+
 void ViewItem::destroy()
 {
 	DP_LOGD("ViewItem::destroy");
@@ -101,13 +130,30 @@ void ViewItem::destroy()
 	}
 }
 
-void ViewItem::updateCB(void *data)
+unsigned int ViewItem::labelGeneration = 0;
+
+void ViewItem::invalidateAllLabels()
+{
+	labelGeneration++;
+}
+
+void ViewItem::invalidateLabels(unsigned int changed)
+{
+	if (changed & CHANGE::TITLE)
+		m_validLabels &= ~LABEL_TITLE;
+	if (changed & (CHANGE::PROGRESS | CHANGE::STATE | CHANGE::ERROR))
+		m_validLabels &= ~LABEL_MESSAGE;
+	if (changed & CHANGE::STATE)
+		m_validLabels &= ~LABEL_DATE;
+}
+
+void ViewItem::updateCB(void *data, unsigned int changed)
 {
 	if (data)
-		static_cast<ViewItem*>(data)->updateFromItem();
+		static_cast<ViewItem*>(data)->updateFromItem(changed);
 }
 
-void ViewItem::updateFromItem()
+void ViewItem::updateFromItem(unsigned int changed)
 {
 	DownloadView &view = DownloadView::getInstance();
 	DP_LOGD("ViewItem::updateFromItem() ITEM::[%d]", state());
@@ -117,6 +163,11 @@ void ViewItem::updateFromItem()
 		if (m_item)
 			m_item->deSubscribe(m_aptr_observer.get());
 		m_aptr_observer->clear();
+		if (m_checkedBtn) {
+			evas_object_event_callback_del_full(m_checkedBtn,
+				EVAS_CALLBACK_DEL, checkBtnDelCB, this);
+			m_checkedBtn = NULL;
+		}
 		elm_object_item_del(m_glItem);
 		m_glItem = NULL;
 		tempType = dateGroupType();
@@ -124,32 +175,75 @@ void ViewItem::updateFromItem()
 		view.handleGenlistGroupItem(tempType);
 		return;
 	}
-	if (m_glItem == NULL) {
+	invalidateLabels(changed);
+	view.updateActiveState(this);
+	if (m_glItem == NULL || changed == CHANGE::NONE) {
 		return;
 	}
 	if (state() == ITEM::SUSPENDED) {
 		return;
 	} else if (state() == ITEM::DOWNLOADING) {
-		if (fileSize() > 0 && m_progressBar) {
+		m_pendingChanged |= changed;
+		view.queueRefresh(this);
+	} else if (m_isRetryCase && state() == ITEM::RECEIVING_DOWNLOAD_INFO) {
+		m_pendingChanged = CHANGE::NONE;
+		elm_genlist_item_item_class_update(m_glItem,
+			view.genlistItemClass(GENLIST_ITEM_CLASS::DOWNLOADING));
+		__count_item_update(true);
+	} else if (!isFinished()) {
+		if (changed & (CHANGE::STATE | CHANGE::TITLE | CHANGE::ICON |
+			CHANGE::ERROR)) {
+			m_pendingChanged = CHANGE::NONE;
+			elm_genlist_item_update(m_glItem);
+			__count_item_update(true);
+		} else {
+			/* Only the progress is changed before downloading */
+			m_pendingChanged |= changed;
+			view.queueRefresh(this);
+		}
+	} else {/* finished state */
+		m_pendingChanged = CHANGE::NONE;
+		__count_item_update(true);
+		if (state() == ITEM::FINISH_DOWNLOAD)
+			elm_genlist_item_item_class_update(m_glItem,
+				view.genlistItemClass(GENLIST_ITEM_CLASS::HISTORY));
+		else
+			elm_genlist_item_item_class_update(m_glItem,
+				view.genlistItemClass(GENLIST_ITEM_CLASS::FAILED));
+		if (view.isGenlistEditMode())
+			elm_object_item_disabled_set(m_glItem, EINA_FALSE);
+	}
+}
+
+void ViewItem::refreshProgress()
+{
+	unsigned int changed = m_pendingChanged;
+	m_pendingChanged = CHANGE::NONE;
+	if (m_glItem == NULL || changed == CHANGE::NONE)
+		return;
+
+	if (state() == ITEM::DOWNLOADING) {
+		if ((changed & CHANGE::PROGRESS) && fileSize() > 0 && m_progressBar) {
 			double percentageProgress = 0.0;
 			percentageProgress = (double)(receivedFileSize()) /
 				(double)(fileSize());
 			DP_LOGD("progress value[%.2f]",percentageProgress);
 			elm_progressbar_value_set(m_progressBar, percentageProgress);
 		}
+		if (changed & (CHANGE::PROGRESS | CHANGE::STATE))
+			elm_genlist_item_fields_update(m_glItem,"elm.text.2",
+				ELM_GENLIST_ITEM_FIELD_TEXT);
+		if (changed & CHANGE::TITLE)
+			elm_genlist_item_fields_update(m_glItem,"elm.text.1",
+				ELM_GENLIST_ITEM_FIELD_TEXT);
+		if (changed & CHANGE::ICON)
+			elm_genlist_item_fields_update(m_glItem,"elm.icon.1",
+				ELM_GENLIST_ITEM_FIELD_CONTENT);
+		__count_item_update(false);
+	} else if (!isFinished() && state() != ITEM::SUSPENDED) {
 		elm_genlist_item_fields_update(m_glItem,"elm.text.2",
 			ELM_GENLIST_ITEM_FIELD_TEXT);
-	} else if (m_isRetryCase && state() == ITEM::RECEIVING_DOWNLOAD_INFO) {
-		elm_genlist_item_item_class_update(m_glItem, &dldGenlistStyle);
-	} else if (!isFinished()) {
-		elm_genlist_item_update(m_glItem);
-	} else {/* finished state */
-		if (state() == ITEM::FINISH_DOWNLOAD)
-			elm_genlist_item_item_class_update(m_glItem, &dldHistoryGenlistStyle);
-		else
-			elm_genlist_item_item_class_update(m_glItem, &dldGenlistSlideStyle);
-		if (view.isGenlistEditMode())
-			elm_object_item_disabled_set(m_glItem, EINA_FALSE);
+		__count_item_update(false);
 	}
 }
 
@@ -175,29 +269,68 @@ char *ViewItem::getGenlistLabel(Evas_Object *obj, 	const char *part)
 #else
 	if (strncmp(part, "elm.text.1", strlen("elm.text.1")) == 0) {
 #endif
-		return strdup(getTitle());
+		return strdup(titleLabel());
 	} else if (strncmp(part, "elm.text.2", strlen("elm.text.2")) == 0) {
-		return strdup(getMessage());
+		return strdup(messageLabel());
 	} else if (strncmp(part, "elm.text.3", strlen("elm.text.3")) == 0) {
-		if (!isFinished()) {
+		if (!isFinished())
 			return NULL;
-		} else {
-			string outBuf;
-			DateUtil &inst = DateUtil::getInstance();
-			double udateTime = finishedTime() * 1000;
-			if (dateGroupType() == DATETIME::DATE_TYPE_PREVIOUS
-				|| dateGroupType() == DATETIME::DATE_TYPE_LATER)
-				inst.getDateStr(LOCALE_STYLE::SHORT_DATE, udateTime, outBuf);
-			else
-				inst.getDateStr(LOCALE_STYLE::TIME, udateTime, outBuf);
-			return strdup(outBuf.c_str());
-		}
+		else
+			return strdup(dateLabel());
 	} else {
 		DP_LOGD("No Implementation");
 		return NULL;
 	}
 }
 
+/* Labels are made only when they are changed.
+ * So realizing the item again by scrolling does not format them again */
+const char *ViewItem::titleLabel()
+{
+	if (m_labelGeneration != labelGeneration) {
+		m_validLabels = 0;
+		m_labelGeneration = labelGeneration;
+	}
+	if (!(m_validLabels & LABEL_TITLE)) {
+		m_titleLabel = getTitle();
+		m_validLabels |= LABEL_TITLE;
+	}
+	return m_titleLabel.c_str();
+}
+
+const char *ViewItem::messageLabel()
+{
+	if (m_labelGeneration != labelGeneration) {
+		m_validLabels = 0;
+		m_labelGeneration = labelGeneration;
+	}
+	if (!(m_validLabels & LABEL_MESSAGE)) {
+		getMessage(m_messageLabel);
+		m_validLabels |= LABEL_MESSAGE;
+	}
+	return m_messageLabel.c_str();
+}
+
+const char *ViewItem::dateLabel()
+{
+	if (m_labelGeneration != labelGeneration) {
+		m_validLabels = 0;
+		m_labelGeneration = labelGeneration;
+	}
+	if (!(m_validLabels & LABEL_DATE)) {
+		DateUtil &inst = DateUtil::getInstance();
+		double udateTime = finishedTime() * 1000;
+		m_dateLabel.clear();
+		if (dateGroupType() == DATETIME::DATE_TYPE_PREVIOUS
+			|| dateGroupType() == DATETIME::DATE_TYPE_LATER)
+			inst.getDateStr(LOCALE_STYLE::SHORT_DATE, udateTime, m_dateLabel);
+		else
+			inst.getDateStr(LOCALE_STYLE::TIME, udateTime, m_dateLabel);
+		m_validLabels |= LABEL_DATE;
+	}
+	return m_dateLabel.c_str();
+}
+
 Evas_Object *ViewItem::getGenlistIconCB(void *data, Evas_Object *obj,
 	const char *part)
 {
@@ -218,9 +351,13 @@ Evas_Object *ViewItem::getGenlistIcon(Evas_Object *obj, const char *part)
 	if (elm_genlist_decorate_mode_get(obj) && isFinished()) {
 		if (strncmp(part,"elm.edit.icon.1", strlen("elm.edit.icon.1")) == 0) {
 			Evas_Object *checkBtn = elm_check_add(obj);
+			/* The check button changes m_checked directly */
+			checkedValue();
 			elm_check_state_pointer_set(checkBtn, &m_checked);
 			evas_object_smart_callback_add(checkBtn, "changed", checkChangedCB,
 				this);
+			evas_object_event_callback_add(checkBtn, EVAS_CALLBACK_DEL,
+				checkBtnDelCB, this);
 			m_checkedBtn = checkBtn;
 			return checkBtn;
 		} else if (strncmp(part,"elm.edit.icon.2", strlen("elm.edit.icon.2")) ==
@@ -240,10 +377,8 @@ Evas_Object *ViewItem::getGenlistIcon(Evas_Object *obj, const char *part)
 	} else if (strncmp(part,"elm.icon.1", strlen("elm.icon.1")) == 0 ||
 		strncmp(part, "elm.icon", strlen("elm.icon")) == 0) {
 //	if (strncmp(part,"elm.icon.1", strlen("elm.icon.1")) == 0) {
-		Evas_Object *icon = elm_icon_add(obj);
-		elm_icon_file_set(icon, getIconPath(), NULL);
-		evas_object_size_hint_aspect_set(icon, EVAS_ASPECT_CONTROL_VERTICAL,1,1);
-		return icon;
+		DownloadView &view = DownloadView::getInstance();
+		return view.createIcon(obj, iconType());
 	} else if (strcmp(part,"elm.swallow.progress") == 0) {
 		return createProgressBar(obj);
 #ifndef _TIZEN_PUBLIC
@@ -269,9 +404,19 @@ void ViewItem::checkChangedCB(void *data, Evas_Object *obj,
 {
 	DownloadView &view = DownloadView::getInstance();
 	DP_LOGD_FUNC();
-	//ViewItem *item = static_cast<ViewItem *>(data);
+	ViewItem *item = static_cast<ViewItem *>(data);
 	//DP_LOGD("checked[%d] viewItem[%p]",(bool)(item->checkedValue()),item);
-	view.handleCheckedState();
+	view.handleCheckedState(item);
+}
+
+/* The check button is deleted when the item is unrealized
+ * or the edit mode is finished */
+void ViewItem::checkBtnDelCB(void *data, Evas *evas, Evas_Object *obj,
+	void *event_info)
+{
+	ViewItem *item = static_cast<ViewItem *>(data);
+	if (item && item->m_checkedBtn == obj)
+		item->m_checkedBtn = NULL;
 }
 
 #ifndef _TIZEN_PUBLIC
@@ -333,13 +478,13 @@ void ViewItem::clickedGenlistItem()
 		return;
 	}
 	if (view.isGenlistEditMode()) {
-		m_checked = !m_checked;
+		setCheckedValue(!checkedValue());
 		if (m_checkedBtn)
 			elm_genlist_item_fields_update(genlistItem(),"elm.edit.icon.1",
 				ELM_GENLIST_ITEM_FIELD_CONTENT);
 		else
 			DP_LOGE("m_checkedBtn is NULL");
-		view.handleCheckedState();
+		view.handleCheckedState(this);
 	} else if (state() == ITEM::FINISH_DOWNLOAD) {
 		bool ret = m_item->play();
 		if (ret == false) {
@@ -354,16 +499,17 @@ void ViewItem::clickedGenlistItem()
 
 Elm_Genlist_Item_Class *ViewItem::elmGenlistStyle()
 {
+	DownloadView &view = DownloadView::getInstance();
 	/* Change the genlist style class in case of download history item */
 	if (state() == ITEM::FINISH_DOWNLOAD)
-		return &dldHistoryGenlistStyle;
+		return view.genlistItemClass(GENLIST_ITEM_CLASS::HISTORY);
 	else if (isFinishedWithErr())
-		 return &dldGenlistSlideStyle;
+		return view.genlistItemClass(GENLIST_ITEM_CLASS::FAILED);
 	else
-		return &dldGenlistStyle;
+		return view.genlistItemClass(GENLIST_ITEM_CLASS::DOWNLOADING);
 }
 
-const char *ViewItem::getMessage()
+void ViewItem::getMessage(string &outBuf)
 {
 	DP_LOGD("ViewItem state() ITEM::[%d]", state());
 	const char *buff = NULL;
@@ -378,9 +524,9 @@ const char *ViewItem::getMessage()
 		break;
 	case ITEM::DOWNLOADING:
 	case ITEM::SUSPENDED:
-		buff = getHumanFriendlyBytesStr(receivedFileSize(), true);
-//		DP_LOGD("%s", buff);
-		break;
+		getHumanFriendlyBytesStr(receivedFileSize(), true, outBuf);
+//		DP_LOGD("%s", outBuf.c_str());
+		return;
 	case ITEM::CANCEL:
 		buff = S_("IDS_COM_POP_CANCELLED");
 		break;
@@ -397,11 +543,11 @@ const char *ViewItem::getMessage()
 		buff = "";
 		break;
 	}
-	return buff;
+	outBuf = buff ? buff : "";
 }
 
-const char *ViewItem::getHumanFriendlyBytesStr(unsigned long int bytes,
-	bool progressOption)
+void ViewItem::getHumanFriendlyBytesStr(unsigned long int bytes,
+	bool progressOption, string &outBuf)
 {
 	double doubleTypeBytes = 0.0;
 	const char *unitStr[4] = {"B", "KB", "MB", "GB"};
@@ -438,8 +584,7 @@ const char *ViewItem::getHumanFriendlyBytesStr(unsigned long int bytes,
 			snprintf(str, sizeof(str), "%.2f %s", doubleTypeBytes, unitStr[unit]);
 	}
 	str[63] = '\0';
-	string temp = string(str);
-	return temp.c_str();
+	outBuf = str;
 }
 
 unsigned long int ViewItem::receivedFileSize()
@@ -512,10 +657,29 @@ Evas_Object *ViewItem::createProgressBar(Evas_Object *parent)
 	return progress;
 }
 
+Eina_Bool ViewItem::checkedValue()
+{
+	DownloadView &view = DownloadView::getInstance();
+	if (m_checkGeneration != view.checkGeneration()) {
+		m_checked = view.checkBase();
+		m_checkGeneration = view.checkGeneration();
+	}
+	return m_checked;
+}
+
+void ViewItem::setCheckedValue(Eina_Bool b)
+{
+	DownloadView &view = DownloadView::getInstance();
+	m_checked = b;
+	m_checkGeneration = view.checkGeneration();
+}
+
 void ViewItem::updateCheckedBtn()
 {
-	if (m_checkedBtn)
+	if (m_checkedBtn) {
+		checkedValue();
 		elm_check_state_pointer_set(m_checkedBtn,&m_checked);
+	}
 }
 
 #ifndef _TIZEN_PUBLIC
@@ -613,14 +777,32 @@ void ViewItem::extractDateGroupType()
 	m_dateGroupType = DATETIME::DATE_TYPE_TODAY;
 }
 
+void ViewItem::extractDateGroupType(DayBoundary &boundary)
+{
+	if (isFinished() && finishedTime() > 0) {
+		DateUtil &inst = DateUtil::getInstance();
+		m_dateGroupType = inst.getDateGroupType(boundary,
+			(time_t)finishedTime());
+		return;
+	}
+	m_dateGroupType = DATETIME::DATE_TYPE_TODAY;
+}
+
 
 void ViewItem::retryViewItem(void)
 {
 	DownloadView &view = DownloadView::getInstance();
 	DP_LOGD_FUNC();
 	if (m_item) {
+		/* The history entry is kept if its url cannot be read */
+		if (!m_item->loadRetryData()) {
+			string desc = S_("IDS_COM_POP_FAILED");
+			view.showErrPopup(desc);
+			return;
+		}
 		m_isRetryCase = true;
 		m_item->clearForRetry();
+		view.updateActiveState(this);
 		if (!m_item->retry()) {
 			DownloadView &view = DownloadView::getInstance();
 			string desc = S_("IDS_COM_POP_FAILED");
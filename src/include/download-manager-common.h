@@ -56,6 +56,14 @@
 #define MAX_BUF_LEN 256
 
 #define LOAD_HISTORY_COUNT 500
+/* The first page of history at startup. It fills one screen */
+#define LOAD_HISTORY_FIRST_COUNT 20
+/* The count of Item, ViewItem or Observer objects in one slab page */
+#define SLAB_OBJS_PER_PAGE 64
+/* Minimum interval of progress drawing in seconds.
+ * 0 means every frame of the animator */
+#define PROGRESS_REFRESH_INTERVAL 0.0
+#define PROGRESS_REFRESH_INTERVAL_LOW_POWER 1.0
 
 enum
 {
@@ -43,6 +43,14 @@ enum {
 };
 }
 
+/* Start times of the days around now.
+ * Date groups of many items are found from this without localtime() for each */
+struct DayBoundary {
+	time_t yesterday;
+	time_t today;
+	time_t tomorrow;
+};
+
 namespace LOCALE_STYLE{
 enum {
 	TIME = 0,
@@ -82,6 +90,8 @@ public:
 	inline void setTodayStandardTime(void) { m_todayStandardTime = time(NULL); }
 	int getDiffDaysFromToday(void);
 	int getDiffDays(time_t nowTime, time_t refTime);
+	void getDayBoundary(DayBoundary &boundary);
+	int getDateGroupType(DayBoundary &boundary, time_t refTime);
 	void updateLocale(void);
 	void getDateStr(int style, double time, string &outBuf);
 	inline double nowTime(void) { return (double)(time(NULL)); }
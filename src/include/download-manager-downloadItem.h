@@ -47,7 +47,7 @@ enum STATE {
 
 class DownloadItem {
 public:
-	DownloadItem();	/* FIXME remove after cleanup ecore_pipe */
+	DownloadItem();	/* FIXME remove after cleanup callback events */
 	DownloadItem(auto_ptr<DownloadRequest> request);
 	~DownloadItem();
 
@@ -90,7 +90,7 @@ public:
 	inline DL_TYPE::TYPE downloadType(void) { return m_downloadType; }
 	inline void setDownloadType(DL_TYPE::TYPE t) { m_downloadType = t;}
 
-	inline void notify(void) { m_subject.notify(); }
+	inline void notify(unsigned int changed) { m_subject.notify(changed); }
 	inline void subscribe(Observer *o) { if (o) m_subject.attach(o); }
 	inline void deSubscribe(Observer *o) { if (o) m_subject.detach(o); }
 	inline string &url(void) { return m_aptr_request->getUrl(); }
@@ -122,6 +122,8 @@ private:
 	string m_mimeType;
 	DL_TYPE::TYPE m_downloadType;
 	int m_download_id;
+	/* Id which is given to the callbacks of the current handle */
+	unsigned long m_cbId;
 };
 
 class DownloadEngine {
@@ -133,6 +135,8 @@ public:
 
 	void initEngine(void);
 	void deinitEngine(void);
+	unsigned long deliveredProgressCount(void);
+	unsigned long coalescedProgressCount(void);
 private:
 	DownloadEngine(void);
 	~DownloadEngine(void);
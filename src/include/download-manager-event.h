@@ -22,28 +22,53 @@
 #ifndef DOWNLOAD_MANAGER_EVENT_H
 #define DOWNLOAD_MANAGER_EVENT_H
 
-#include <vector>
-/* For debug */
 #include <string>
 
 using namespace std;
 
+/* Fields which are changed by an event.
+ * Observers update only the parts which show the changed fields */
+namespace CHANGE {
+enum FIELD {
+	NONE = 0,
+	PROGRESS = 1 << 0,
+	STATE = 1 << 1,
+	TITLE = 1 << 2,
+	ICON = 1 << 3,
+	ERROR = 1 << 4,
+	ALL = PROGRESS | STATE | TITLE | ICON | ERROR
+};
+}
+
 class Observer;
+
+/* Observers are linked into the subject through their own links.
+ * So attach and detach don't allocate memory and take constant time.
+ * An observer can be detached while notifying, even if it is the next one */
 class Subject
 {
 public:
-	Subject(){}
-	~Subject(){}
+	Subject();
+	~Subject();
 
 	void attach(Observer *);
 	void detach(Observer *);
-	void notify(void);
+	void notify(unsigned int changed = CHANGE::ALL);
 
 private:
-	vector<Observer*> _observers;
+	/* The position of notify() which is running.
+	 * It is chained when notify() is called again in an update function */
+	struct NotifyCursor {
+		Observer *next;
+		NotifyCursor *outer;
+	};
+
+	Observer *m_head;
+	Observer *m_tail;
+	NotifyCursor *m_cursor;
 };
 
-typedef void (*updateFunction)(void *data);
+typedef void (*updateFunction)(void *data, unsigned int changed);
 
 class Observer
 {
@@ -51,22 +76,29 @@ public:
 	/* For debug */
 	Observer(updateFunction uf, void *data, const char *name);
 	//Observer(updateFunction uf, void *data);
-	~Observer(){}
+	~Observer();
+	/* Allocated from the slab of this class */
+	static void *operator new(size_t size);
+	static void operator delete(void *p);
 
-	void update(Subject *s);
+	void update(Subject *s, unsigned int changed);
 	void set(updateFunction uf, void *data);
 	void clear(void);
 	void *getUserData(void) { return m_userData; }
 	/* For debug */
-	string name(void) { return observerName; }
+	const char *name(void) { return observerName; }
 
 private:
-	void call(void);
+	friend class Subject;
+	void call(unsigned int changed);
 
 	updateFunction m_updateFunction;
 	void *m_userData;
-	/* For debug */
-	string observerName;
+	/* For debug. It should be a string literal */
+	const char *observerName;
+	Subject *m_subject;
+	Observer *m_prev;
+	Observer *m_next;
 };
 
 #endif /* DOWNLOAD_MANAGER_EVENT_H */
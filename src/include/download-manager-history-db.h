@@ -25,7 +25,12 @@
 
 #include <string>
 #include <queue>
+#include <deque>
+#include <map>
+#include <vector>
+#include <pthread.h>
 #include <db-util.h>
+#include <Ecore.h>
 #include "download-manager-item.h"
 extern "C" {
 #include <unicode/utypes.h>
@@ -33,24 +38,205 @@ extern "C" {
 
 using namespace std;
 
+/* Position of the history loading.
+ * History is ordered by date (and id for the same date) from the latest one,
+ * and each page starts right after the last row of the previous page. */
+class HistoryCursor
+{
+public:
+	HistoryCursor(void);
+	~HistoryCursor(void) {}
+
+	bool loadNext(int limit);
+	inline bool isStarted(void) { return m_isStarted; }
+	inline bool isEnd(void) { return m_isEnd; }
+	inline double lastDate(void) { return m_lastDate; }
+	inline int lastId(void) { return m_lastId; }
+	void moveTo(double date, int id);
+	inline void setEnd(void) { m_isEnd = true; }
+
+private:
+	double m_lastDate;
+	int m_lastId;
+	bool m_isStarted;
+	bool m_isEnd;
+};
+
+/* One sqlite connection and its prepared statements.
+ * A connection should be used only by one thread. */
+class HistoryDBConnection
+{
+public:
+	HistoryDBConnection(void);
+	~HistoryDBConnection(void);
+
+	bool open(void);
+	void close(void);
+	inline bool isOpen(void) { return m_db ? true : false; }
+	inline sqlite3 *handle(void) { return m_db; }
+	bool execSQL(const char *query);
+	sqlite3_stmt *getStatement(const char *query);
+	void releaseStatement(sqlite3_stmt *stmt);
+
+private:
+	void finalizeStatements(void);
+
+	sqlite3 *m_db;
+	/* Prepared statements are kept until the DB is closed. Key is the query */
+	map<string, sqlite3_stmt *> m_stmtCache;
+};
+
+namespace HISTORY_OP {
+enum TYPE {
+	INSERT,
+	DELETE,
+	DELETE_MULTIPLE,
+	CLEAR,
+	CHECKPOINT
+};
+}
+
+namespace HISTORY_DB {
+enum DURABILITY {
+	/* WAL journal and synchronous=NORMAL.
+	 * The last commits can be lost at power failure, but the DB is not broken */
+	DURABILITY_DEFAULT,
+	/* No sync at all. This is only for benchmark */
+	DURABILITY_FAST
+};
+}
+
+/* A history change which is waiting for the DB writer thread.
+ * Item data is copied, because the item can be destroyed before writing */
+struct HistoryOp {
+	HISTORY_OP::TYPE type;
+	unsigned long long historyId;
+	int downloadType;
+	int contentType;
+	int state;
+	int err;
+	string name;
+	string path;
+	string url;
+	string cookie;
+	double date;
+	queue <unsigned long long> ids;
+};
+
+/* A decoded history row. It is made by the reader thread
+ * and turned into an item at the main loop.
+ * Url and cookie are not here, because they are needed only for retry */
+struct HistoryRow {
+	unsigned long long historyId;
+	int downloadType;
+	int contentType;
+	int state;
+	int err;
+	string name;
+	string path;
+	double date;
+};
+
+/* Called at the main loop after each batch of rows is added to the view.
+ * isFailed is set with isEnd if the rest of history cannot be read */
+typedef void (*HistoryReadCB)(void *data, int rowCount, bool isEnd,
+	bool isFailed);
+
 class DownloadHistoryDB
 {
 public:
+	static void setDurability(HISTORY_DB::DURABILITY d) { durability = d; }
+	static bool initDB(void);
+	static void deinitDB(void);
+	static void flush(void);
 	static bool addToHistoryDB(Item *item);
-	static bool createRemainedItemsFromHistoryDB(int limit, int offset);
-	static bool createItemsFromHistoryDB(void);
-	static bool deleteItem(unsigned int historyId);
-	static bool deleteMultipleItem(queue <unsigned int> &q);
+	static bool createItemsFromHistoryDB(HistoryCursor &cursor, int limit);
+	static bool startReader(HistoryReadCB cb, void *data);
+	static void stopReader(void);
+	static bool deleteItem(unsigned long long historyId);
+	static bool getRetryData(unsigned long long historyId, string &url,
+		string &cookie);
+	static bool deleteMultipleItem(queue <unsigned long long> &q);
+	static unsigned long long createHistoryId(void);
 	static bool clearData(void);
-	static bool getCountOfHistory(int *count);
+	static unsigned long queuedWriteCount(void);
+	static unsigned long committedWriteCount(void);
 private:
 	DownloadHistoryDB(void);
 	~DownloadHistoryDB(void);
-	static sqlite3* historyDb;
+	/* Used at the main loop */
+	static HistoryDBConnection historyDb;
+	/* Used only at the writer thread */
+	static HistoryDBConnection writerDb;
 	static bool open(void);
-	static bool isOpen(void) { return historyDb ? true : false; }
 	static void close(void);
+	static int getSchemaVersion(HistoryDBConnection &conn);
+	static bool setSchemaVersion(HistoryDBConnection &conn, int version);
+	static bool migrate(HistoryDBConnection &conn);
+	static void loadNextHistoryId(void);
+	static bool applyDurability(HistoryDBConnection &conn);
+	static bool openWriter(void);
+	static int walHookCB(void *data, sqlite3 *db, const char *dbName,
+		int pages);
+	static Eina_Bool checkpointIdleEntererCB(void *data);
+	static bool checkpoint(void);
+	static bool readHistoryRows(HistoryDBConnection &conn,
+		HistoryCursor &cursor, int limit, vector<HistoryRow> &rows);
+	static void createItemsFromRows(vector<HistoryRow> &rows);
+	static Item *createItemFromRow(HistoryRow &row);
+	static unsigned int getColumnText(sqlite3_stmt *stmt, int col,
+		string &outBuf);
+	static void *readerThreadMain(void *data);
+	static Eina_Bool readerFdHandlerCB(void *data,
+		Ecore_Fd_Handler *fdHandler);
+
+	static bool startWriter(void);
+	static void stopWriter(void);
+	static void *writerThreadMain(void *data);
+	static bool pushOp(HistoryOp *op);
+	static bool writeOps(deque<HistoryOp *> &ops, unsigned long *committed);
+	static void dropOps(deque<HistoryOp *> &ops);
+	static bool applyOpInSavepoint(HistoryOp *op, bool *isApplied);
+	static bool applyOp(HistoryOp *op);
+	static bool applyInsert(HistoryOp *op);
+	static bool applyDelete(HistoryOp *op);
+	static bool applyDeleteMultiple(HistoryOp *op);
+	static bool applyClear(HistoryOp *op);
+
+	static pthread_t writerThread;
+	static pthread_mutex_t writerMutex;
+	static pthread_cond_t writerCond;
+	static pthread_cond_t flushCond;
+	static deque<HistoryOp *> pendingOps;
+	static bool isWriterRunning;
+	static bool isWriting;
+	static unsigned long queuedCount;
+	static unsigned long committedCount;
+	/* Used only at the reader thread */
+	static HistoryDBConnection readerDb;
+	static pthread_t readerThread;
+	static pthread_mutex_t readerMutex;
+	static pthread_cond_t readerCond;
+	/* Batches which are read and not added to the view yet */
+	static deque<vector<HistoryRow> *> readBatches;
+	static bool isReaderRunning;
+	static bool isReadDone;
+	static bool isReadFailed;
+	/* The main loop is woken up by this when a batch is read */
+	static int readerEventFd;
+	static Ecore_Fd_Handler *readerFdHandler;
+	static HistoryReadCB readerCB;
+	static void *readerCBData;
+	static HISTORY_DB::DURABILITY durability;
+	static Ecore_Idle_Enterer *checkpointIdleEnterer;
+	/* Pages in the WAL file since the last checkpoint */
+	static int walPages;
+	/* Set by a commit. A checkpoint is tried again only after a new commit,
+	 * because the pages used by a reader cannot be copied until then */
+	static bool isWalCommitted;
+	static bool isCheckpointQueued;
+	/* Used only at the main loop */
+	static unsigned long long nextHistoryId;
 };
 
 #endif	/* DOWNLOAD_MANAGER_HISTORY_DB_H */
-
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include "download-manager-event.h"
 #include "download-manager-downloadRequest.h"
 #include "download-manager-downloadItem.h"
@@ -31,6 +32,9 @@
 
 using namespace std;
 
+/* History id of the item which is not saved to history DB */
+#define INVALID_HISTORY_ID ((unsigned long long)-1)
+
 namespace ITEM {
 enum STATE {
 	IDLE = 0,
@@ -53,8 +57,12 @@ public:
 	static void create(DownloadRequest &rRequest);
 	static Item *createHistoryItem(void);
 	~Item(void);
+	/* Allocated from the slab of this class */
+	static void *operator new(size_t size);
+	static void operator delete(void *p);
 
-	void attachHistoryItem(void);
+	/* Items of a history page, ordered from the latest one */
+	static void attachHistoryItems(vector<Item *> &historyItems);
 	void destroy(void);
 	/* SHOULD call this before destrying an item*/
 	void deleteFromDB(void);
@@ -66,6 +74,7 @@ public:
 		return;
 	}
 	void clearForRetry(void);
+	bool loadRetryData(void);
 	bool retry(void);
 
 	bool play(void);
@@ -73,9 +82,9 @@ public:
 	inline void subscribe(Observer *o) { m_subjectForView.attach(o); }
 	inline void deSubscribe(Observer *o) { m_subjectForView.detach(o); }
 
-	static void updateCBForDownloadObserver(void *data);
-	static void netEventCBObserver(void *data);
-	void updateFromDownloadItem(void);
+	static void updateCBForDownloadObserver(void *data, unsigned int changed);
+	static void netEventCBObserver(void *data, unsigned int changed);
+	void updateFromDownloadItem(unsigned int changed);
 	inline void suspend(void) { m_aptr_downloadItem->suspend(); }
 
 	inline int id(void) {
@@ -110,22 +119,27 @@ public:
 		return m_emptyString;
 	}
 
-	inline void setHistoryId(unsigned int i) { m_historyId = i; }
-	inline unsigned int historyId(void) { return m_historyId; }	// FIXME duplicated with m_id
+	void setHistoryId(unsigned long long i);
+	inline unsigned long long historyId(void) { return m_historyId; }	// FIXME duplicated with m_id
 	inline string &title(void) {return m_title;}
 	inline void setTitle(string &title) { m_title = title; }
+	/* Take the string without copying. It is used for history rows */
+	inline void swapTitle(string &title) { m_title.swap(title); }
 	string &registeredFilePath(void);
 	inline void setRegisteredFilePath(string &r) { m_registeredFilePath = r; }
+	inline void swapRegisteredFilePath(string &r) { m_registeredFilePath.swap(r); }
 	string &url(void);
 	string &cookie(void);
-	void setRetryData(string &url, string &cookie);
 	int contentType(void) { return m_contentType; }
 	inline void setContentType(int t) { m_contentType = t; }
 	DL_TYPE::TYPE downloadType(void);
 	inline void setDownloadType(DL_TYPE::TYPE t) { m_downloadType = t; }
 
 //	string &getIconPath(void) {return m_iconPath; }
-	inline string &iconPath(void) { return m_iconPath; }
+	/* Content type which decides the icon. The view caches icons by it */
+	inline int iconType(void) { return m_iconType; }
+	inline const char *iconPath(void) { return iconPathOfType(m_iconType); }
+	static const char *iconPathOfType(int type);
 
 	inline void setState(ITEM::STATE state) { m_state = state; }
 	inline ITEM::STATE state(void) { return m_state; }
@@ -148,15 +162,15 @@ private:
 	Item(void);
 	Item(DownloadRequest &rRequest);
 
-	inline void notify(void) { m_subjectForView.notify(); }
+	inline void notify(unsigned int changed) { m_subjectForView.notify(changed); }
 
 	void createSubscribeData(void);
 	void extractTitle(void);
 	void extractIconPath(void);
 
-	void startUpdate(void);
+	unsigned int startUpdate(void);
 	void createHistoryId(void);
-	bool isExistedHistoryId(unsigned int id);
+	bool isExistedHistoryId(unsigned long long id);
 	void handleFinishedItem(void);
 
 	auto_ptr<DownloadRequest> m_aptr_request;
@@ -170,9 +184,9 @@ private:
 	ITEM::STATE m_state;
 	ERROR::CODE m_errorCode;
 	string m_title;
-	unsigned int m_historyId;
+	unsigned long long m_historyId;
 	int m_contentType;
-	string m_iconPath; // FIXME Later:is it right to exist here? (ViewItem or not)
+	int m_iconType;
 	string m_emptyString; // FIXME this is temporary to avoid crash when filePath() is called if m_aptr_downloaditem points nothing
 	double m_finishedTime;
 	DL_TYPE::TYPE m_downloadType;
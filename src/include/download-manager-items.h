@@ -23,7 +23,8 @@
 #define DOWNLOAD_MANAGER_ITEMS_H
 
 #include "download-manager-item.h"
-#include <vector>
+#include <tr1/unordered_map>
+#include <tr1/unordered_set>
 
 class Items {
 public:
@@ -34,12 +35,18 @@ public:
 
 	void attachItem(Item *item);
 	void detachItem(Item *item);
-	bool isExistedHistoryId(unsigned int id);
+	bool isExistedHistoryId(unsigned long long id);
+	Item *findItemByHistoryId(unsigned long long id);
+	/* Called by Item when its history id is changed */
+	void changeHistoryId(Item *item, unsigned long long oldId,
+		unsigned long long newId);
 private:
 	Items(){}
 	~Items(){DP_LOGD_FUNC();}
 
-	vector<Item*> m_items;
+	tr1::unordered_set<Item*> m_items;
+	/* Only the items which have a valid history id */
+	tr1::unordered_map<unsigned long long, Item*> m_historyItems;
 };
 
 #endif /* DOWNLOAD_MANAGER_ITEMS_H */
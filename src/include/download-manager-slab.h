@@ -0,0 +1,72 @@
+/*
+ * Copyright 2012  Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.tizenopensource.org/license
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file	download-manager-slab.h
+ * @brief	Slab allocator for small objects which are created per item
+ */
+#ifndef DOWNLOAD_MANAGER_SLAB_H
+#define DOWNLOAD_MANAGER_SLAB_H
+
+#include <stddef.h>
+
+/* Objects of one size are packed into pages which hold a fixed count of them.
+ * A page is freed when all of its objects are freed.
+ * An object which is larger than the slot, e.g. of a derived class,
+ * is allocated alone by malloc.
+ * It is used only at the main loop, so it is not thread safe */
+class SlabAllocator {
+public:
+	SlabAllocator(const char *name, size_t objSize, int objsPerPage);
+	~SlabAllocator();
+
+	void *alloc(size_t size);
+	void free(void *p);
+
+	inline unsigned long pageCount(void) { return m_pageCount; }
+	inline unsigned long objectCount(void) { return m_objectCount; }
+
+private:
+	struct Page;
+	struct Slot {
+		/* NULL if the object is allocated alone */
+		Page *page;
+		Slot *nextFree;
+	};
+	struct Page {
+		Page *prev;
+		Page *next;
+		Slot *freeSlots;
+		int usedCount;
+	};
+
+	Page *createPage(void);
+	void destroyPage(Page *page);
+	void linkPage(Page *page);
+	void unlinkPage(Page *page);
+
+	/* For debug. It should be a string literal */
+	const char *m_name;
+	size_t m_objSize;
+	size_t m_slotSize;
+	int m_objsPerPage;
+	/* Pages which have free slots */
+	Page *m_freePages;
+	unsigned long m_pageCount;
+	unsigned long m_objectCount;
+};
+
+#endif /* DOWNLOAD_MANAGER_SLAB_H */
@@ -27,6 +27,7 @@
 #include <libintl.h>
 
 #include <vector>
+#include <tr1/unordered_set>
 #include "download-manager-common.h"
 #include "download-manager-viewItem.h"
 #include "download-manager-dateTime.h"
@@ -36,6 +37,16 @@ enum {
 	POPUP_EVENT_ERR,
 };
 
+/* Genlist item classes which are shared by all view items */
+namespace GENLIST_ITEM_CLASS {
+enum TYPE {
+	DOWNLOADING = 0,
+	HISTORY,
+	FAILED,
+	MAX
+};
+}
+
 class DownloadView {
 public:
 	static DownloadView& getInstance(void) {
@@ -54,6 +65,7 @@ public:
 	void hide(void);
 
 	void attachViewItem(ViewItem *viewItem);
+	void attachViewItems(vector<ViewItem *> &viewItems);
 	void detachViewItem(ViewItem *viewItem);
 
 	void changedRegion(void);
@@ -64,7 +76,10 @@ public:
 	void showViewItem(int id, const char *title);
 	void playContent(int id, const char *title);
 	void handleChangedAllCheckedState(void);
-	void handleCheckedState(void);
+	void handleCheckedState(ViewItem *viewItem);
+	void updateActiveState(ViewItem *viewItem);
+	inline unsigned int checkGeneration(void) { return m_checkGeneration; }
+	inline Eina_Bool checkBase(void) { return m_checkBase; }
 	bool isGenlistEditMode(void);
 	void handleGenlistGroupItem(int type);
 #ifndef _TIZEN_PUBLIC
@@ -72,8 +87,13 @@ public:
 	ViewItem *sweepedItem(void) { return m_sweepedItem; }
 #endif
 	void moveRetryItem(ViewItem *viewItem);
+	void queueRefresh(ViewItem *viewItem);
+	void setRefreshInterval(double interval);
+	inline Elm_Genlist_Item_Class *genlistItemClass(
+		GENLIST_ITEM_CLASS::TYPE type) { return m_genlistItemClass[type]; }
 	static char *getGenlistGroupLabelCB(void *data, Evas_Object *obj,
 		const char *part);
+	Evas_Object *createIcon(Evas_Object *parent, int iconType);
 
 private:
 	static void showNotifyInfoCB(void *data, Evas *evas, Evas_Object *obj, void *event);
@@ -93,6 +113,8 @@ private:
 	static void cancelClickCB(void *data, Evas_Object *obj, void *event_info);
 	static void errPopupResponseCB(void *data, Evas_Object *obj, void *event_info);
 	static Eina_Bool deletedNotifyTimerCB(void *data);
+	static Eina_Bool refreshAnimatorCB(void *data);
+	static Eina_Bool refreshTimerCB(void *data);
 
 private:
 	DownloadView();
@@ -110,6 +132,12 @@ private:
 	void createControlBar(void);
 	void createBox(void);
 	void createList(void);
+	void createGenlistItemClass(void);
+	void destroyGenlistItemClass(void);
+	void refreshQueuedItems(void);
+	void cancelRefresh(ViewItem *viewItem);
+	Evas_Object *cachedIcon(Evas *evas, int iconType);
+	void clearIconCache(void);
 
 	void removeTheme(void);
 
@@ -165,12 +193,30 @@ private:
 	Evas_Object *eoAllCheckedBox;
 	Evas_Object *eoNotifyInfoLayout;
 	Elm_Genlist_Item_Class dldGenlistGroupStyle;
+	Elm_Genlist_Item_Class *m_genlistItemClass[GENLIST_ITEM_CLASS::MAX];
 	Eina_Bool m_allChecked;
 #ifndef _TIZEN_PUBLIC
 	ViewItem *m_sweepedItem;
 #endif
 
 	int m_viewItemCount;
+	/* View items which are not finished. They are disabled at edit mode */
+	tr1::unordered_set<ViewItem *> m_activeItems;
+	/* A view item which is not checked or unchecked since the generation
+	 * is changed has m_checkBase as its checked value */
+	unsigned int m_checkGeneration;
+	Eina_Bool m_checkBase;
+	int m_checkedCount;
+	/* View items of which progress is drawn at the next frame */
+	vector<ViewItem *> m_refreshItems;
+	Ecore_Animator *m_refreshAnimator;
+	/* Waits until the refresh interval is passed without animator ticks */
+	Ecore_Timer *m_refreshTimer;
+	double m_refreshInterval;
+	double m_lastRefreshTime;
+	/* Hidden image per content type. It keeps the decoded icon in the
+	 * evas image cache, so the icons of the rows share its data */
+	Evas_Object *m_iconCache[DP_CONTENT_UNKOWN + 1];
 	DateGroup m_today;
 	DateGroup m_yesterday;
 	DateGroup m_previousDay;
@@ -25,6 +25,7 @@
 
 #include "download-manager-event.h"
 #include "download-manager-item.h"
+#include "download-manager-dateTime.h"
 #include <Elementary.h>
 #include <memory>
 
@@ -33,7 +34,11 @@ using namespace std;
 class ViewItem {
 public:
 	~ViewItem();
+	/* Allocated from the slab of this class */
+	static void *operator new(size_t size);
+	static void operator delete(void *p);
 	static void create(Item *item);
+	static void createHistory(vector<Item *> &items);
 	void destroy(void);
 	inline void deleteFromDB(void) {
 		if (m_item)
@@ -41,7 +46,7 @@ public:
 	}
 
 	inline void setItem(Item *item) { m_item = item; }
-	static void updateCB(void *);
+	static void updateCB(void *data, unsigned int changed);
 
 
 	static char *getGenlistLabelCB(void *data, Evas_Object *obj,
@@ -53,25 +58,28 @@ public:
 	Evas_Object *getGenlistIcon(Evas_Object *obj, const char *part);
 
 	static void checkChangedCB(void *data, Evas_Object *obj, void *event_info);
+	static void checkBtnDelCB(void *data, Evas *evas, Evas_Object *obj,
+		void *event_info);
+
+	/* Called by the view at the frame after the progress is changed */
+	void refreshProgress(void);
+	inline bool isRefreshQueued(void) { return m_isRefreshQueued; }
+	inline void setRefreshQueued(bool b) { m_isRefreshQueued = b; }
 
 #ifndef _TIZEN_PUBLIC
 	void sweepRight(void);
 	void sweepLeft(void);
 #endif
 
-	const char *getMessage(void);
+	void getMessage(string &outBuf);
 	const char *getBytesStr(void);
-	const char *getHumanFriendlyBytesStr(unsigned long int bytes,
-		bool progressOption);
+	void getHumanFriendlyBytesStr(unsigned long int bytes,
+		bool progressOption, string &outBuf);
+	/* Called when the locale is changed */
+	static void invalidateAllLabels(void);
 
 	Elm_Genlist_Item_Class *elmGenlistStyle(void);
 
-	inline Elm_Genlist_Item_Class *elmGenlistItemClass(void)
-		{ return &dldGenlistStyle; }
-	inline Elm_Genlist_Item_Class *elmGenlistHistoryItemClass(void)
-		{ return &dldHistoryGenlistStyle; }
-	inline Elm_Genlist_Item_Class *elmGenlistFailedItemClass(void)
-		{ return &dldGenlistSlideStyle; }
 	inline ITEM::STATE state(void) {
 		if (m_item)
 			return m_item->state();
@@ -113,7 +121,8 @@ public:
 	unsigned long int fileSize(void);
 	const char *getTitle(void);
 	inline const char *getErrMsg(void) { return m_item->getErrorMessage(); }
-	const char *getIconPath(void) { return m_item->iconPath().c_str(); }
+	inline const char *getIconPath(void) { return m_item->iconPath(); }
+	inline int iconType(void) { return m_item->iconType(); }
 
 	inline Elm_Object_Item *genlistItem(void) { return m_glItem; }
 	inline void setGenlistItem(Elm_Object_Item *glItem) { m_glItem = glItem; }
@@ -124,24 +133,42 @@ public:
 	void clickedRetryButton(void);
 	void clickedGenlistItem(void);
 	void requestCancel(void);
-	inline Eina_Bool checkedValue(void) { return m_checked; }
-	void setCheckedValue(Eina_Bool b) { m_checked = b; }
+	Eina_Bool checkedValue(void);
+	void setCheckedValue(Eina_Bool b);
 	inline Evas_Object *checkedBtn(void) { return m_checkedBtn; }
 	void setCheckedBtn(Evas_Object *e) { m_checkedBtn = e; }
+	inline bool isActive(void) { return m_isActive; }
+	inline void setActive(bool b) { m_isActive = b; }
 
 	void updateCheckedBtn(void);
 
 	inline int dateGroupType(void) { return m_dateGroupType; }
-	void setDateGroupType (int t) { m_dateGroupType = t; }
+	void setDateGroupType (int t) {
+		if (m_dateGroupType != t)
+			m_validLabels &= ~LABEL_DATE;
+		m_dateGroupType = t;
+	}
 
 	inline double finishedTime(void) { return m_item->finishedTime();}
 	void extractDateGroupType(void);
+	void extractDateGroupType(DayBoundary &boundary);
 
-	inline unsigned int historyId(void) { return m_item->historyId(); }
+	inline unsigned long long historyId(void) { return m_item->historyId(); }
 private:
+	/* Labels which are kept in the cache */
+	enum {
+		LABEL_TITLE = 1 << 0,
+		LABEL_MESSAGE = 1 << 1,
+		LABEL_DATE = 1 << 2
+	};
+
 	ViewItem(Item *item);
+	void invalidateLabels(unsigned int changed);
+	const char *titleLabel(void);
+	const char *messageLabel(void);
+	const char *dateLabel(void);
 
-	void updateFromItem(void);
+	void updateFromItem(unsigned int changed);
 	Evas_Object *createProgressBar(Evas_Object *parent);
 #ifndef _TIZEN_PUBLIC
 	Evas_Object *createDeleteBtn(Evas_Object *parent);
@@ -160,15 +187,27 @@ private:
 	auto_ptr<Observer> m_aptr_observer;
 	Item *m_item;
 
-	Elm_Genlist_Item_Class dldGenlistStyle;
-	Elm_Genlist_Item_Class dldHistoryGenlistStyle;
-	Elm_Genlist_Item_Class dldGenlistSlideStyle;
 	Elm_Object_Item *m_glItem;
 	Evas_Object *m_progressBar;
 	Evas_Object *m_checkedBtn;
 	Eina_Bool m_checked;
+	/* m_checked is valid only at this check generation of the view */
+	unsigned int m_checkGeneration;
 	bool m_isRetryCase;
+	/* Whether the view counts this as an unfinished item */
+	bool m_isActive;
+	/* Changes which are not drawn yet */
+	unsigned int m_pendingChanged;
+	bool m_isRefreshQueued;
 	int m_dateGroupType;
+	/* Rendered labels for genlist. They are valid while the bit of
+	 * m_validLabels is set and m_labelGeneration is the current one */
+	string m_titleLabel;
+	string m_messageLabel;
+	string m_dateLabel;
+	unsigned int m_validLabels;
+	unsigned int m_labelGeneration;
+	static unsigned int labelGeneration;
 };
 
 #endif /* DOWNLOAD_MANAGER_VIEW_ITEM_H */
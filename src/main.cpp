@@ -40,10 +40,20 @@ using namespace std;
 
 struct app_data_t {
 	Ecore_Idler *idler;
-	int history_count;
-	int load_count;
+	HistoryCursor *historyCursor;
+	Evas *evas;
+	/* Startup stages are logged with the time from this */
+	double startTime;
+	bool isFirstRowWatched;
+	bool isFirstRowRendered;
 };
 
+static void __trace_startup(struct app_data_t *app_data, const char *stage)
+{
+	DP_LOG("startup [%s] time[%.3f]", stage,
+		ecore_time_get() - app_data->startTime);
+}
+
 #ifndef _TIZEN_PUBLIC
 int __get_rotate_angle()
 {
@@ -68,6 +78,8 @@ static void __rotate_changed_cb(app_device_orientation_e m, void *data)
 static void __lang_changed_cb(void *data)
 {
 	DP_LOG("=== Language changed nofification ===");
+	/* Translated labels are made again when they are realized */
+	ViewItem::invalidateAllLabels();
 	return;
 }
 
@@ -85,26 +97,85 @@ static void __low_memory_cb(void *data)
 	return;
 }
 
-static Eina_Bool __load_remained_history(void *data)
+static void __first_row_rendered_cb(void *data, Evas *e, void *event_info)
+{
+	struct app_data_t *app_data = (struct app_data_t *)data;
+	if (!app_data)
+		return;
+	evas_event_callback_del_full(e, EVAS_CALLBACK_RENDER_POST,
+		__first_row_rendered_cb, app_data);
+	app_data->isFirstRowRendered = true;
+	__trace_startup(app_data, "first row visible");
+}
+
+/* Trace the render after the first rows are added */
+static void __watch_first_row(struct app_data_t *app_data)
+{
+	if (app_data->isFirstRowWatched || !app_data->evas)
+		return;
+	app_data->isFirstRowWatched = true;
+	evas_event_callback_add(app_data->evas, EVAS_CALLBACK_RENDER_POST,
+		__first_row_rendered_cb, app_data);
+}
+
+static Eina_Bool __load_history(void *data);
+
+static void __history_read_cb(void *data, int rowCount, bool isEnd,
+	bool isFailed)
+{
+	struct app_data_t *app_data = (struct app_data_t *)data;
+	if (!app_data)
+		return;
+	if (rowCount > 0)
+		__watch_first_row(app_data);
+	/* Read it again at idle time. The rows which are already in the view
+	 * are skipped by their history id */
+	if (isFailed && !app_data->idler) {
+		DP_LOGE("Fail to read history at the reader thread");
+		app_data->historyCursor = new HistoryCursor();
+		app_data->idler = ecore_idler_add(__load_history, app_data);
+		return;
+	}
+	if (isEnd)
+		__trace_startup(app_data, "all rows loaded");
+}
+
+/* This is used when the reader thread cannot be started or read history.
+ * Idlers are called after the first frame is rendered.
+ * So the window is shown before the history is loaded.
+ * The first page fills one screen and the rest is loaded page by page */
+static Eina_Bool __load_history(void *data)
 {
 	struct app_data_t *app_data = (struct app_data_t *)data;
-	if (app_data && app_data->load_count <= app_data->history_count) {
-		app_data->load_count += LOAD_HISTORY_COUNT;
-		DownloadHistoryDB::createRemainedItemsFromHistoryDB(
-			LOAD_HISTORY_COUNT, app_data->load_count);
-		return ECORE_CALLBACK_RENEW;
-	} else
+	if (!app_data)
 		return ECORE_CALLBACK_CANCEL;
+	HistoryCursor *cursor = app_data->historyCursor;
+	if (cursor) {
+		bool isFirstPage = !cursor->isStarted();
+		bool ret = cursor->loadNext(isFirstPage ?
+			LOAD_HISTORY_FIRST_COUNT : LOAD_HISTORY_COUNT);
+		if (cursor->isStarted())
+			__watch_first_row(app_data);
+		if (ret && !cursor->isEnd())
+			return ECORE_CALLBACK_RENEW;
+	}
+	__trace_startup(app_data, "all rows loaded");
+
+	delete app_data->historyCursor;
+	app_data->historyCursor = NULL;
+	app_data->idler = NULL;
+	return ECORE_CALLBACK_CANCEL;
 }
 
 static bool __app_create(void *data)
 {
-	int count = 0;
 #ifndef _TIZEN_PUBLIC
 	int angle = 0;
 #endif
 	struct app_data_t *app_data = (struct app_data_t *)data;
 	DP_LOG_START("App Create");
+	if (app_data)
+		app_data->startTime = ecore_time_get();
 
 	DownloadView &view = DownloadView::getInstance();
 	Evas_Object *window = view.create();
@@ -124,16 +195,19 @@ static bool __app_create(void *data)
 	evas_object_show(window);
 	view.show();
 #endif
+	if (app_data) {
+		app_data->evas = evas_object_evas_get(window);
+		__trace_startup(app_data, "window created");
+	}
 
-	DownloadHistoryDB::getCountOfHistory(&count);
-	if (count > 0) {
-		DownloadHistoryDB::createItemsFromHistoryDB();
-		if (count > LOAD_HISTORY_COUNT) {
-			if (app_data) {
-				app_data->history_count = count;
-				app_data->idler = ecore_idler_add(__load_remained_history, app_data);
-			}
-		}
+	if (!DownloadHistoryDB::initDB())
+		DP_LOGE("Fail to open history DB");
+	/* The reader finds the end of history, so the rows are not counted */
+	if (app_data && !DownloadHistoryDB::startReader(__history_read_cb,
+			app_data)) {
+		DP_LOGE("Fail to start reader thread. History is read at idle time");
+		app_data->historyCursor = new HistoryCursor();
+		app_data->idler = ecore_idler_add(__load_history, app_data);
 	}
 
 	DP_LOG_END("App Create");
@@ -151,6 +225,15 @@ static void __app_terminate(void *data)
 	view.destroy();
 	if (app_data && app_data->idler)
 		ecore_idler_del(app_data->idler);
+	if (app_data && app_data->historyCursor) {
+		delete app_data->historyCursor;
+		app_data->historyCursor = NULL;
+	}
+	if (app_data && app_data->isFirstRowWatched &&
+			!app_data->isFirstRowRendered)
+		evas_event_callback_del_full(app_data->evas,
+			EVAS_CALLBACK_RENDER_POST, __first_row_rendered_cb, app_data);
+	DownloadHistoryDB::deinitDB();
 	if (app_data) {
 		free(app_data);
 		app_data = NULL;
@@ -161,11 +244,16 @@ static void __app_terminate(void *data)
 static void __app_pause(void *data)
 {
 	DP_LOG_FUNC();
+	/* Progress is not seen, so it is drawn less often to save power */
+	DownloadView &view = DownloadView::getInstance();
+	view.setRefreshInterval(PROGRESS_REFRESH_INTERVAL_LOW_POWER);
 	return;
 }
 
 static void __app_resume(void *data)
 {
+	DownloadView &view = DownloadView::getInstance();
+	view.setRefreshInterval(PROGRESS_REFRESH_INTERVAL);
 	return;
 }
 